@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2023 pabletefest
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#pragma once
+#include "emu_typedefs.h"
+
+#include <array>
+#include <vector>
+
+// Number of decoded blocks kept (power of two) and maximum instructions per block
+#ifndef GB_BLOCK_CACHE_SIZE
+    #ifdef ESP32
+        #define GB_BLOCK_CACHE_SIZE 64
+    #else
+        #define GB_BLOCK_CACHE_SIZE 1024
+    #endif
+#endif
+
+#ifndef GB_BLOCK_MAX_INSTRUCTIONS
+    #define GB_BLOCK_MAX_INSTRUCTIONS 16
+#endif
+
+namespace gb
+{
+    class GBConsole;
+
+    // Instruction fetched and split up ahead of time, so running it again doesn't touch the bus
+    struct DecodedInstruction
+    {
+        u8 operand[2]; // Immediate bytes as stored in ROM (8 or 16 bits), or the extended opcode after 0xCB
+        u8 opcode;
+        u8 length;
+    };
+
+    // Direct mapped cache of straight-line runs of ROM code, keyed by (bank, start address). ROM contents
+    // never change, so a block stays valid for as long as its bank is mapped where it was decoded from.
+    class BlockCache
+    {
+    public:
+        // Bank key of code that can't be cached (RAM, or ROM with no cartridge inserted)
+        static constexpr u16 NO_BANK = 0xFFFF;
+        // Bank key of the boot ROM overlaying 0x0000-0x00FF
+        static constexpr u16 BOOT_ROM_BANK = 0xFFFE;
+
+        struct Block
+        {
+            u16 bank = NO_BANK;
+            u16 startAddress = 0;
+            u8 count = 0;
+            std::array<DecodedInstruction, GB_BLOCK_MAX_INSTRUCTIONS> instructions;
+        };
+
+        // Blocks found already decoded (hits) and decoded on the spot (misses)
+        struct Stats
+        {
+            u32 hits = 0;
+            u32 misses = 0;
+        };
+
+        BlockCache();
+        ~BlockCache() = default;
+
+        // Block starting at address in the given bank, decoding it on a miss. Returns nullptr when
+        // not even the first instruction fits before the end of the bank
+        auto getBlock(GBConsole& bus, u16 bank, u16 address) -> const Block*;
+
+        // Needed whenever the ROM itself changes (another cartridge inserted)
+        auto clear() -> void;
+
+        inline auto getStats() const -> const Stats& { return stats; }
+
+    private:
+        auto decode(GBConsole& bus, Block& block, u16 bank, u16 address) -> void;
+
+    private:
+        std::vector<Block> blocks;
+        Stats stats;
+    };
+}
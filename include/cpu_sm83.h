@@ -6,7 +6,35 @@
  */
 
 #pragma once
-#include "emu_typedefs.h" 
+#include "emu_typedefs.h"
+#include "block_cache.h"
+
+// Opcodes are dispatched through compile time generated handler tables by default, defining
+// GB_CPU_SWITCH_DISPATCH goes back to the switch statements (Xtensa codegen differs between both).
+// GB_CPU_THREADED_DISPATCH runs the handlers inlined in a computed goto loop (GCC/Clang labels as values)
+#if defined(GB_CPU_SWITCH_DISPATCH)
+    #define GB_CPU_DISPATCH_NAME "switch dispatch"
+#elif defined(GB_CPU_THREADED_DISPATCH)
+    #ifndef __GNUC__
+        #error "GB_CPU_THREADED_DISPATCH requires the labels as values extension (GCC or Clang)"
+    #endif
+    #define GB_CPU_DISPATCH_NAME "threaded dispatch"
+#else
+    #define GB_CPU_DISPATCH_NAME "table dispatch"
+#endif
+
+// GB_CPU_M_CYCLE_ACCURATE moves time forward 4 T-cycles before every bus access of an instruction, instead of
+// all at once after it, so PPU and timer registers are seen and written at their real timing (timing test ROMs).
+// Internal M-cycles are still added after the accesses: only stack accesses (PUSH, CALL, RST, RET cc, interrupt
+// dispatch) happen a cycle early, no IO access follows an internal M-cycle
+#ifdef GB_CPU_M_CYCLE_ACCURATE
+    #ifdef GB_CPU_THREADED_DISPATCH
+        #error "GB_CPU_M_CYCLE_ACCURATE can't be combined with GB_CPU_THREADED_DISPATCH"
+    #endif
+    #define GB_CPU_TIMING_NAME "M-cycle timing"
+#else
+    #define GB_CPU_TIMING_NAME "instruction timing"
+#endif
 
 namespace gb
 {
@@ -17,107 +45,27 @@ namespace gb
         C, H, N, Z
     };
 
+#ifdef GB_CPU_LAZY_FLAGS
+    // ALU operations whose flags are worked out from their operands and result only when read
+    enum class FlagsOperation : u8
+    {
+        None, Add, Sub, Inc, Dec, And, OrXor, Shift, RotateA
+    };
+#endif
+
     // The GameBoy CPU called SM83
     class SM83CPU
     {
     public:
-        explicit SM83CPU(GBConsole* device);
-        ~SM83CPU() = default;
-
-        auto read8(const u16& address) -> u8;
-        auto read16(const u16& address) -> u16;
-        
-        auto write8(const u16& address, const u8& data) -> void;
-        auto write16(const u16& address, const u16& data) -> void;
-
-        auto reset() -> void;
-        auto clock() -> void;
-
-        constexpr auto getFlag(Flags flag) -> u8
-        {
-            switch (flag)
-            {
-            case C:
-                return regs.flags.C;
-                break;
-            case H:
-                return regs.flags.H;
-                break;
-            case N:
-                return regs.flags.N;
-                break;
-            case Z:
-                return regs.flags.Z;
-                break;
-            default:
-                return 0;
-                break;
-            }
-        }
-
-        constexpr auto setFlag(Flags flag, u8 value) -> void
-        {
-            switch (flag)
-            {
-            case C:
-                regs.flags.C = value ? 1 : 0;
-                break;
-            case H:
-                regs.flags.H = value ? 1 : 0;
-                break;
-            case N:
-                regs.flags.N = value ? 1 : 0;
-                break;
-            case Z:
-                regs.flags.Z = value ? 1 : 0;
-                break;
-            default:
-                break;
-            }
-        }
-
-        auto checkPendingInterrupts() -> bool;
-        auto interruptServiceRoutine() -> u8;
-        inline auto isInterruptEnablePending() -> bool { return interruptEnablePending; };
-        inline auto setInterruptEnablePending() -> void { interruptEnablePending = true; };
-        inline auto discardInterruptEnablePending() -> void { interruptEnablePending = false; };
-        auto setRegisterValuesPostBootROM() -> void;
-
-    private:
-        auto decodeAndExecuteInstruction(u8 opcode) -> void;
-        auto decodeAndExecuteCBInstruction(u8 cbOpcode) -> void;
-
-    private:
-        u32 cpuT_CyclesElapsed = 0;
-        u32 cpuM_CyclesElapsed = 0;
-
-        u8 interruptRoutineCycle = 0;
-        bool interruptEnablePending = false;
-
-    public:
-        GBConsole* system = nullptr;
-        u8 instructionCycles = 0;
-
+        // Flat register file: F is a plain byte (Z/N/H/C in bits 7-4), paired with the next register on
+        // little endian targets (x86-64, ARM and Xtensa alike)
         struct Registers
         {
             union
             {
                 struct
                 {
-                    union
-                    {
-                        struct
-                        {
-                            u8 unused : 4;
-                            u8 C : 1;
-                            u8 H : 1;
-                            u8 N : 1;
-                            u8 Z : 1;
-                        }flags;
-
-                        u8 F;
-                    };
-
+                    u8 F;
                     u8 A;
                 };
 
@@ -159,6 +107,271 @@ namespace gb
 
             u16 SP;
             u16 PC;
-        }regs;
+        };
+
+        // Hot state, touched by every instruction. It goes first in the CPU, itself the first member of GBConsole,
+        // so it shares a cache line and stays within the short immediate offsets of Xtensa loads (0-255 bytes
+        // for l8ui), instead of each access first building the address of a member past the memory arrays
+        Registers regs;
+        u8 instructionCycles = 0;
+        bool IME = false;
+        u64 systemCycles = 0; // T-cycles since power on, the clock of the whole console
+        GBConsole* system = nullptr;
+
+    public:
+        explicit SM83CPU(GBConsole* device);
+        ~SM83CPU() = default;
+
+        auto read8(const u16& address) -> u8;
+        auto read16(const u16& address) -> u16;
+        
+        auto write8(const u16& address, const u8& data) -> void;
+        auto write16(const u16& address, const u16& data) -> void;
+
+        auto reset() -> void;
+        auto clock() -> void;
+        auto step() -> u8; // Executes a whole instruction (or interrupt dispatch) and returns its T-cycles
+#ifdef GB_CPU_THREADED_DISPATCH
+        // Executes instructions back to back, adding their T-cycles to systemCycles, until it reaches cycleLimit
+        // or the next scheduled event, or the CPU halts. Events are left for the caller to dispatch
+        auto run(u64 cycleLimit) -> void;
+#endif
+
+        constexpr auto getFlag(Flags flag) -> u8
+        {
+#ifdef GB_CPU_LAZY_FLAGS
+            if (pendingFlags.operation != FlagsOperation::None)
+                return computePendingFlag(flag);
+#endif
+
+            return (regs.F >> (4 + flag)) & 0x01;
+        }
+
+        constexpr auto setFlag(Flags flag, u8 value) -> void
+        {
+            materializeFlags(); // The other flags keep their value
+
+            u8 mask = 0x10 << flag;
+            regs.F = value ? (regs.F | mask) : (regs.F & ~mask);
+        }
+
+#ifdef GB_CPU_LAZY_FLAGS
+        // Records the operation instead of setting Z/N/H/C. carry is the carry in (Add/Sub), the carry out
+        // (Shift/RotateA) or the carry flag left untouched (Inc/Dec)
+        constexpr auto deferFlags(FlagsOperation operation, u16 left, u16 right, u8 carry, u16 result) -> void
+        {
+            pendingFlags = { operation, carry, left, right, result };
+        }
+
+        constexpr auto computePendingFlag(Flags flag) const -> u8
+        {
+            const PendingFlags& pending = pendingFlags;
+
+            switch (flag)
+            {
+            case Z:
+                if (pending.operation == FlagsOperation::RotateA)
+                    return 0;
+
+                if (pending.operation == FlagsOperation::Add || pending.operation == FlagsOperation::Sub
+                    || pending.operation == FlagsOperation::Inc)
+                    return (pending.result & 0xFF) == 0;
+
+                return pending.result == 0;
+            case N:
+                return pending.operation == FlagsOperation::Sub || pending.operation == FlagsOperation::Dec;
+            case H:
+                switch (pending.operation)
+                {
+                case FlagsOperation::Add:
+                    return ((pending.left & 0x0F) + (pending.right & 0x0F) + pending.carry) > 0x0F;
+                case FlagsOperation::Sub:
+                    return (static_cast<int>(pending.left & 0x0F) - (pending.right & 0x0F) - pending.carry) < 0;
+                case FlagsOperation::Inc:
+                    return (pending.result & 0x0F) == 0;
+                case FlagsOperation::Dec:
+                    return ((pending.result + 1) & 0x0F) == 0;
+                case FlagsOperation::And:
+                    return 1;
+                default:
+                    return 0;
+                }
+            case C:
+                if (pending.operation == FlagsOperation::Add || pending.operation == FlagsOperation::Sub)
+                    return pending.result > 0xFF;
+
+                if (pending.operation == FlagsOperation::And || pending.operation == FlagsOperation::OrXor)
+                    return 0;
+
+                return pending.carry;
+            default:
+                return 0;
+            }
+        }
+#endif
+
+        // Brings regs.F up to date before it's read as a whole (PUSH AF, save states), no-op unless lazy flags
+        constexpr auto materializeFlags() -> void
+        {
+#ifdef GB_CPU_LAZY_FLAGS
+            if (pendingFlags.operation == FlagsOperation::None)
+                return;
+
+            regs.F = (computePendingFlag(Z) << 7) | (computePendingFlag(N) << 6) | (computePendingFlag(H) << 5)
+                | (computePendingFlag(C) << 4) | (regs.F & 0x0F);
+            pendingFlags.operation = FlagsOperation::None;
+#endif
+        }
+
+        // Drops the recorded operation when F gets overwritten as a whole (POP AF, register setup, state loads)
+        constexpr auto discardPendingFlags() -> void
+        {
+#ifdef GB_CPU_LAZY_FLAGS
+            pendingFlags.operation = FlagsOperation::None;
+#endif
+        }
+
+        // T-cycles the last instruction already moved time forward through its bus accesses (0 unless M-cycle timing)
+        inline auto takeBusCycles() -> u32
+        {
+            u32 cycles = busCycles;
+            busCycles = 0;
+            return cycles;
+        }
+
+        auto checkPendingInterrupts() -> bool;
+        auto interruptServiceRoutine() -> u8;
+        inline auto isInterruptEnablePending() -> bool { return interruptEnablePending; };
+        inline auto setInterruptEnablePending() -> void { interruptEnablePending = true; };
+        inline auto discardInterruptEnablePending() -> void { interruptEnablePending = false; };
+        auto setRegisterValuesPostBootROM() -> void;
+        // Runs the instruction after a HALT that didn't halt (IME off, interrupt pending), reading its first byte twice
+        auto executeHaltBug() -> void;
+
+        // Immediate operands of the instruction being executed. The opcode fetch points operandBytes at them
+        // (decoded block, or the memory page when the whole instruction fits in it), otherwise they go through the bus
+        inline auto fetch8() -> u8
+        {
+            if (operandBytes)
+            {
+                tickBusAccess();
+                regs.PC++;
+                return *operandBytes++;
+            }
+
+            return read8(regs.PC++);
+        }
+
+        inline auto fetch16() -> u16
+        {
+            u16 data;
+
+            if (operandBytes)
+            {
+                tickBusAccess();
+                tickBusAccess();
+                data = operandBytes[0] | (operandBytes[1] << 8);
+                operandBytes += 2;
+            }
+            else
+            {
+                data = read16(regs.PC);
+            }
+
+            regs.PC += 2;
+            return data;
+        }
+
+        // Decoded blocks are keyed by ROM bank, so they only go stale when the ROM itself changes
+        inline auto clearBlockCache() -> void { blockCache.clear(); currentBlock = nullptr; }
+        inline auto getBlockCacheStats() const -> const BlockCache::Stats& { return blockCache.getStats(); }
+
+        // Busy-wait loops on LY/STAT fast-forwarded, and the T-cycles they would have spent spinning
+        struct IdleLoopStats
+        {
+            u32 hits = 0;
+            u64 cyclesSkipped = 0;
+        };
+
+        inline auto getIdleLoopStats() const -> const IdleLoopStats& { return idleLoopStats; }
+        inline auto resetIdleLoopStats() -> void { idleLoopStats = {}; rejectedLoopAddress = 0xFFFF; idleLoopAddress = 0xFFFF; }
+
+        // Called by conditional JRs taken a few bytes back. When the loop only polls LY or STAT, which just change
+        // on scheduled PPU events, the iterations that would still read the old value are skipped at once
+        auto skipIdleLoop(u16 loopStart, u16 branchAddress) -> void;
+
+        template <typename Visitor>
+        auto serialize(Visitor& state) -> void
+        {
+            if constexpr (Visitor::loading)
+                discardPendingFlags();
+            else
+                materializeFlags();
+
+            state.value(regs);
+            state.value(instructionCycles);
+            state.value(cpuT_CyclesElapsed);
+            state.value(cpuM_CyclesElapsed);
+            state.value(interruptRoutineCycle);
+            state.value(interruptEnablePending);
+        }
+
+    private:
+        auto decodeAndExecuteInstruction(u8 opcode) -> void;
+        auto decodeAndExecuteCBInstruction(u8 cbOpcode) -> void;
+
+        // Compile time generated handler per opcode, used unless GB_CPU_SWITCH_DISPATCH selects the switches above
+        struct OpcodeHandlers;
+
+        // Fetches the opcode at PC, from the current decoded block while execution runs straight through it
+        auto fetchOpcode() -> u8;
+        auto nextDecodedInstruction() -> const DecodedInstruction*;
+
+        // Advances the rest of the system to the M-cycle of the access about to happen, no-op unless M-cycle timing
+        inline auto tickBusAccess() -> void
+        {
+#ifdef GB_CPU_M_CYCLE_ACCURATE
+            tickMCycle();
+#endif
+        }
+
+        auto tickMCycle() -> void;
+
+        // T-cycles of one iteration of an idle loop between both addresses, 0 if it isn't one
+        auto matchIdleLoop(u16 loopStart, u16 branchAddress) -> u32;
+
+    private:
+        u32 cpuT_CyclesElapsed = 0;
+        u32 cpuM_CyclesElapsed = 0;
+
+        u8 interruptRoutineCycle = 0;
+        bool interruptEnablePending = false;
+
+#ifdef GB_CPU_LAZY_FLAGS
+        struct PendingFlags
+        {
+            FlagsOperation operation = FlagsOperation::None;
+            u8 carry = 0;
+            u16 left = 0;
+            u16 right = 0;
+            u16 result = 0;
+        };
+
+        PendingFlags pendingFlags;
+#endif
+
+        BlockCache blockCache;
+        const BlockCache::Block* currentBlock = nullptr;
+        const u8* operandBytes = nullptr;
+        u32 busCycles = 0;
+        u8 blockPosition = 0;
+        u16 blockNextAddress = 0;
+        u32 blockMappingGeneration = 0;
+
+        IdleLoopStats idleLoopStats;
+        u16 idleLoopAddress = 0xFFFF; // Branch of the last idle loop seen, and when its next iteration starts
+        u64 idleLoopTimestamp = 0;
+        u16 rejectedLoopAddress = 0xFFFF; // Last ROM loop that didn't match, so hot loops aren't decoded every pass
+        u32 rejectedLoopGeneration = 0;
     };
 }
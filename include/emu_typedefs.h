@@ -19,6 +19,9 @@ using i16 = s16;
 using u32 = std::uint32_t;
 using s32 = std::int32_t;
 using i32 = s32;
+using u64 = std::uint64_t;
+using s64 = std::int64_t;
+using i64 = s64;
 
 using vu8 = volatile std::uint8_t;
 using vs8 = volatile std::int8_t;
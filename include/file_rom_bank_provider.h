@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2023 pabletefest
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#pragma once
+#include "rom_bank_provider.h"
+
+#include <array>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace gb
+{
+    // Fixed capacity cache of banks read from the ROM file as the mapper switches them. Bank 0 stays
+    // pinned and the least recently used bank not mapped in the other slot is evicted when the cache is full.
+    // Works the same against SPIFFS on the ESP32 and a regular file on the host.
+    class FileROMBankProvider : public ROMBankProvider
+    {
+    public:
+        // Needs room for bank 0 and the banks of both slots, so at least 3 entries are kept
+        FileROMBankProvider(const std::string& path, u32 romSize, u16 cacheCapacity);
+        ~FileROMBankProvider() override = default;
+
+        // Inherited via ROMBankProvider
+        virtual auto loadBank(u8 slot, u16 bank) -> const u8* override;
+        virtual auto getSize() const -> u32 override { return romSize; }
+
+    private:
+        auto findVictimEntry(u8 slot) const -> u16;
+        auto readBank(u16 bank, u16 entry) -> void;
+
+    private:
+        static constexpr u16 NO_ENTRY = 0xFFFF;
+        static constexpr u32 NO_BANK = 0xFFFFFFFF;
+
+        std::ifstream romFile;
+        u32 romSize = 0;
+
+        std::vector<u8> cacheData; // cacheCapacity banks of 16KB
+        std::vector<u32> entryBanks;
+        std::vector<u32> entryLastUse;
+        std::vector<u16> bankEntries; // Cache entry holding each ROM bank, NO_ENTRY if not cached
+        u32 useCounter = 0;
+
+        std::array<u32, 2> slotBanks = { NO_BANK, NO_BANK };
+    };
+}
@@ -0,0 +1,42 @@
+/*
+ * Copyright (C) 2023 pabletefest
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#pragma once
+#include "emu_typedefs.h"
+
+#include <string>
+
+#ifdef ESP32
+    #include <TFT_eSPI.h>
+#else
+    // Same values TFT_eSPI uses so text calls are portable between builds
+    #define TL_DATUM 0
+    #define TR_DATUM 2
+#endif
+
+#define GB_PIXELS_WIDTH 160
+#define GB_PIXELS_HEIGHT 144
+
+namespace gb
+{
+    // Abstract destination of the pixels produced by the PPU. The ESP32 build draws into a
+    // TFT_eSPI sprite while host builds keep the frame in memory (see MemoryFrameSink).
+    class FrameSink
+    {
+    public:
+        virtual ~FrameSink() = default;
+
+        virtual auto getColorDepth() -> u8 = 0;
+        virtual auto drawPixel(s32 x, s32 y, u32 color) -> void = 0;
+        virtual auto readPixelValue(s32 x, s32 y) -> u16 = 0;
+        virtual auto getPixelsBufferData() -> u8* = 0;
+
+        virtual auto presentFrame() -> void = 0;
+        virtual auto printText(const std::string& text, u8 font, u8 datum) -> void = 0;
+        virtual auto printText(const std::string& text, u16 x, u16 y, u8 font, u8 datum) -> void = 0;
+    };
+}
@@ -8,20 +8,29 @@
 #pragma once
 #include "emu_typedefs.h"
 #include "mapper.h"
+#include "no_mbc.h"
+#include "mbc1.h"
+#include "mbc3.h"
+#include "mbc5.h"
+#include "rom_bank_provider.h"
 
+#include <algorithm>
 #include <string>
 #include <memory>
 #include <vector>
 #include <array>
+#include <variant>
 
 namespace gb
 {
+    using MapperVariant = std::variant<NoMBCMapper, MBC1Mapper, MBC3Mapper, MBC5Mapper>;
+
     // Represents an abstraction of a GB cartridge 
     class GamePak : public std::enable_shared_from_this<GamePak>
     {
     public:
         GamePak(const std::string& filename);
-        ~GamePak() = default;
+        ~GamePak();
 
         auto read(u16 addr, u8& data) -> bool;
         auto write(u16 addr, u8 data) -> bool;
@@ -45,9 +54,63 @@ namespace gb
 
         auto getHeaderInfo() const -> const CartridgeHeader&;
 
-        auto getROMBuffer() const -> const u8*;
         auto getRomBufferSize() const -> const u32;
 
+        // Backing memory of the 16KB ROM bank mapped in the given slot and of the mapped cartridge RAM bank
+        // (nullptr when there's no RAM to access directly), used to build the bus page table
+        auto getMappedROMData(u8 slot) const -> const u8*;
+        auto getMappedRAMData() -> u8*;
+        auto getMappedROMBank(u8 slot) const -> u16;
+
+        // Emulated T-cycle counter the cartridge hardware (MBC3 RTC) keeps time from
+        auto connectCycleCounter(const u64* cycleCounter) -> void;
+
+        auto getROMBankStats() const -> ROMBankProvider::Stats;
+
+        // Battery backed RAM writes go through read/write (not the page table) so the 256 bytes pages they touch
+        // are tracked, and only those pages are written back to the save file
+        inline auto tracksRAMWrites() const -> bool { return hasBattery && !vRAMMemory.empty(); }
+
+        // Writes the dirty pages (and the RTC state, if it changed) to the save file, nothing when both are clean
+        auto flushSave() -> void;
+        // Same, but at most once every GB_SAVE_FLUSH_INTERVAL emulated cycles so bursts of writes get coalesced
+        auto flushSaveIfDue() -> void;
+
+        template <typename Visitor>
+        auto serialize(Visitor& state) -> void
+        {
+            std::visit([&state](auto& m) { m.serialize(state); }, mapper);
+            state.bytes(vRAMMemory.data(), static_cast<u32>(vRAMMemory.size()));
+
+            if constexpr (Visitor::loading)
+            {
+                updateROMSlots();
+
+                // The restored RAM replaces what the save file holds
+                if (hasBattery)
+                {
+                    std::fill(dirtyRAMPages.begin(), dirtyRAMPages.end(), true);
+                    saveDirty = true;
+                }
+            }
+        }
+
+    private:
+        // Set up the header and the ROM bank provider, false if the source isn't available
+        auto openROMFile(const std::string& filename) -> bool;
+#ifdef ESP32
+        auto openROMPartition(const char* label) -> bool;
+#endif
+        auto getROMSizeFromHeader() const -> u32;
+
+        auto loadSave() -> void;
+
+        // Points the ROM slots at the banks currently selected by the mapper
+        auto updateROMSlots() -> void;
+
+        // Every mapper derives from Mapper, so the shared bank state is reachable without knowing the alternative
+        auto getMapperState() const -> const Mapper&;
+
     private:
         CartridgeHeader header;
 
@@ -58,7 +121,7 @@ namespace gb
             256 * 1024,
             512 * 1024,
             1 * 1024 * 1024,
-            2 * 1024 * 0124,
+            2 * 1024 * 1024,
             4 * 1024 * 1024,
             8 * 1024 * 1024,
             u32(1.1 * 1024 * 1024),
@@ -78,10 +141,21 @@ namespace gb
         std::string gameName;
 
         //u8 nMapperID = 0;
-        u8 nROMBanks = 0;
+        u16 nROMBanks = 0;
+
+        Scope<ROMBankProvider> romBanks;
+        std::array<const u8*, 2> romSlotData = { nullptr, nullptr };
+        std::vector<u8> vRAMMemory; // External cartridge RAM
 
-        std::vector<u8> vROMMemory;
+        bool hasBattery = false;
+        std::string savePath;
+        std::vector<bool> dirtyRAMPages;
+        bool saveDirty = false;
+        bool fullSaveNeeded = false; // The save file is missing or incomplete
+        MBC3Mapper::RTCState savedRTCState = { }; // What the save file holds after the RAM
+        u64 lastFlushTimestamp = 0;
+        const u64* cycleCounter = nullptr;
 
-        Scope<Mapper> mapper;
+        MapperVariant mapper = NoMBCMapper(2, 0);
     };
 }
@@ -12,6 +12,8 @@
 #include "game_pack.h"
 #include "timer.h"
 #include "ppu.h"
+#include "scheduler.h"
+#include "save_state.h"
 
 #include <array>
 
@@ -19,6 +21,13 @@ namespace gb
 {
     class GBConsole
     {
+    public:
+        // Upper bound of a single HALT fast-forward, only hit when no event is scheduled (LCD and timer off).
+        // Joypad and serial requests the host raises between run() calls wake the CPU on the next call, and
+        // run() never fast-forwards past its budget, so the wake-up latency is the host's run() granularity
+        static constexpr u32 MAX_HALT_SKIP_CYCLES = 456;
+        static constexpr u32 CYCLES_PER_FRAME = 70224;
+
     public:
         enum class InterruptType
         {
@@ -27,40 +36,153 @@ namespace gb
 
     public:
         GBConsole();
-        ~GBConsole() = default;
+        ~GBConsole();
 
         auto insertCartridge(const Ref<GamePak>& cartridge) -> void;
 
-        auto read8(const u16& address) -> u8;
-        auto read16(const u16& address) -> u16;
+        // Plain memory resolves with a single page table lookup, IO and cartridge registers take the slow path
+        inline auto read8(const u16& address) -> u8
+        {
+            const u8* page = readPages[address >> 8];
+            return page ? page[address & 0xFF] : readSlowPath(address);
+        }
 
-        auto write8(const u16& address, const u8& data) -> void;
+        inline auto write8(const u16& address, const u8& data) -> void
+        {
+            u8* page = writePages[address >> 8];
+
+            if (page)
+                page[address & 0xFF] = data;
+            else
+                writeSlowPath(address, data);
+        }
+
+        // Backing memory of the page holding address, nullptr when it's accessed through the handlers
+        inline auto getReadPage(u16 address) const -> const u8* { return readPages[address >> 8]; }
+
+        auto read16(const u16& address) -> u16;
         auto write16(const u16& address, const u16& data) -> void;
 
         auto reset() -> void;
         auto clock() -> void;
         auto step(u32 numberCycles) -> void;
+        auto stepInstruction() -> u32;
+        // Advances everything but the CPU by one M-cycle, called before each bus access in M-cycle timing
+        auto tickMCycle() -> void;
+        // Runs instructions until cycleBudget T-cycles have elapsed or a scheduled event is due, then dispatches
+        // the due events (PPU, timer). Returns the T-cycles run, call it in a loop to cover longer spans
+        auto run(u32 cycleBudget) -> u32;
 
         inline auto getCPU() -> SM83CPU& { return cpu;  }
         inline auto getTimer() -> Timer& { return timer; }
         inline auto getPPU() -> PPU& { return ppu; }
+        inline auto getCartridge() -> const Ref<GamePak>& { return gamePak; }
+        inline auto getScheduler() -> Scheduler& { return scheduler; }
+        inline auto getCyclesElapsed() const -> u64 { return cpu.systemCycles; }
+
+        // Bank the code at a ROM address comes from (BlockCache::NO_BANK outside ROM or without a cartridge),
+        // and a counter bumped every time the ROM mapping may have changed
+        inline auto getROMBankKey(u16 address) const -> u16
+        {
+            if (address > 0x7FFF || !gamePak || dmaActive) // ROM reads may conflict with an OAM DMA
+                return BlockCache::NO_BANK;
+
+            if (address < 0x0100 && (bootROMMappedRegister & 0x01) == 0)
+                return BlockCache::BOOT_ROM_BANK;
+
+            return romSlotBanks[address >> 14];
+        }
+
+        inline auto getROMMappingGeneration() const -> u32 { return romMappingGeneration; }
+
+        // Moves time forward without running anything, only for spans proven to hold no scheduled event
+        inline auto skipCycles(u32 cycles) -> void { cpu.systemCycles += cycles; }
+        // Value of the cycle counter when events were last dispatched, reads from then on see their effects
+        inline auto getLastEventCycles() const -> u64 { return lastEventCycles; }
 
         auto requestInterrupt(InterruptType type) -> void;
         auto getInterruptState(InterruptType type) -> u8;
         inline auto checkPendingInterrupts() -> u8 { return IE.reg & IF.reg & 0x1F; }
         inline auto enterHaltMode() -> void { isHaltMode = true; }
+        auto enterStopMode() -> void;
+        // STOP stops the clock until a selected joypad line goes low. Meanwhile run() returns 0 cycles,
+        // so the host should sleep or block on input instead of calling it in a loop
+        inline auto isStopped() const -> bool { return isStopMode; }
 
         auto getGameTitleFromHeader() -> std::string;
 
+        // Whole machine state (cartridge included) as a versioned blob, the buffer is reused between calls
+        auto saveState(std::vector<u8>& buffer) -> void;
+        // Rejects blobs of another version or ROM, or whose size doesn't match, leaving the machine untouched
+        auto loadState(const u8* data, u32 size) -> bool;
+
     private:
         auto skipBootROM() -> void;
+        auto dispatchEvents() -> void;
+        auto wakeFromStopMode() -> bool;
+        auto stepHalted(u64 cycleLimit) -> u32;
+
+        auto readSlowPath(u16 address) -> u8;
+        auto writeSlowPath(u16 address, u8 data) -> void;
+        auto mapMemoryPages() -> void;
+        auto mapCartridgePages() -> void;
+        auto ejectCartridge() -> void;
+
+        // OAM DMA: 160 bytes, one per M-cycle, while the CPU loses access to OAM and to the bus the source is on
+        auto startOAMDMA(u8 sourcePage) -> void;
+        auto syncOAMDMA(u64 timestamp) -> void;
+        auto onOAMDMAEndEvent(u64 timestamp) -> void;
+        auto mapOAMDMAPages() -> void;
+        auto unmapOAMDMABus() -> void;
+        auto isOAMDMAConflict(u16 address) const -> bool;
+        auto readOAMDMASource(u8 index) -> u8;
+        auto getOAMDMAIndex() const -> u8;
+
+        template <typename Visitor>
+        auto serialize(Visitor& state) -> void
+        {
+            cpu.serialize(state);
+            state.bytes(wram.data(), static_cast<u32>(wram.size()));
+            state.bytes(hram.data(), static_cast<u32>(hram.size()));
+            state.value(cpu.systemCycles);
+            scheduler.serialize(state);
+            state.value(SB_register);
+            state.value(SC_register);
+            timer.serialize(state);
+            state.value(isHaltMode);
+            state.value(isStopMode);
+            ppu.serialize(state);
+            state.value(bootROMMappedRegister);
+            state.value(dmaSourceAddress);
+            state.value(dmaActive);
+            state.value(dmaBytesCopied);
+            state.value(dmaStartCycles);
+            state.value(cpu.IME);
+            state.value(pendingInterrupt);
+            state.value(IE);
+            state.value(IF);
+            state.value(joypadRegister);
+
+            if (gamePak)
+                gamePak->serialize(state);
+        }
+
+        auto getROMGlobalChecksum() const -> u16;
 
     private:
-        SM83CPU cpu;
+        SM83CPU cpu; // First, so the hot CPU state (registers, IME, cycle counter) starts the console object
         std::array<u8, convertKBToBytes(8)> wram;
         std::array<u8, 127> hram;
 
-        u32 systemCyclesElapsed = 0;
+        // Bus page table: base pointer of every 256-byte page, nullptr when accesses need a handler
+        std::array<const u8*, 256> readPages = {};
+        std::array<u8*, 256> writePages = {};
+        std::array<u16, 2> romSlotBanks = {};
+        u32 romMappingGeneration = 0;
+
+        u64 lastEventCycles = 0;
+        u32 pendingClockCycles = 0; // M-cycle timing: T-cycles of the last instruction clock() still has to wait out
+        Scheduler scheduler;
 
         Ref<GamePak> gamePak;
 
@@ -69,15 +191,19 @@ namespace gb
 
         Timer timer;
         bool isHaltMode = false;
+        bool isStopMode = false; // Set along with isHaltMode, so the instruction path only checks the latter
 
         PPU ppu;
 
         u8 bootROMMappedRegister = 0x00;
         
         u8 dmaSourceAddress = 0x00;
+        bool dmaActive = false;
+        u8 dmaBytesCopied = 0;
+        u64 dmaStartCycles = 0;
+        const u8* dmaSourceData = nullptr; // Source page as mapped when the transfer started, nullptr for mapper handled RAM
 
     public:
-        bool IME = false;
         bool pendingInterrupt = false;
 
         union InterruptEnableRegister
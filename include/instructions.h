@@ -136,16 +136,21 @@ namespace gb
         else
             assert(false && "Error in ADD/ADC opcode: Possible errors are wrong OperantType, register passed is not unsigned or it's a temporary variable");
         
+        u8 carry = (addCarryBit) ? cpu->getFlag(gb::C) : 0;
         u16 originalValue = cpu->regs.A;
         u16 originalOperand = result;
-        operand = result + ((addCarryBit) ? cpu->regs.flags.C : 0);
+        operand = result + carry;
         result = cpu->regs.A + operand;
         cpu->regs.A = result & 0x00FF;
 
+#ifdef GB_CPU_LAZY_FLAGS
+        cpu->deferFlags(gb::FlagsOperation::Add, originalValue, originalOperand, carry, result);
+#else
         cpu->setFlag(gb::Z, cpu->regs.A == 0);
         cpu->setFlag(gb::N, 0);
-        cpu->setFlag(gb::H, ((originalValue & 0x0F) + (originalOperand & 0x0F) + ((addCarryBit) ? cpu->regs.flags.C : 0)) > 0x0F);
+        cpu->setFlag(gb::H, ((originalValue & 0x0F) + (originalOperand & 0x0F) + carry) > 0x0F);
         cpu->setFlag(gb::C, result > 0xFF);
+#endif
     }
 
     static auto ADD_SPi8(gb::SM83CPU* cpu, const s8& immediate) -> void
@@ -203,13 +208,21 @@ namespace gb
 
         //operand -= ((subCarryBit) ? cpu->regs.flags.C : 0);
 
-        result = cpu->regs.A - operand - ((subCarryBit) ? cpu->regs.flags.C : 0);
+        u8 carry = (subCarryBit) ? cpu->getFlag(gb::C) : 0;
+#ifdef GB_CPU_LAZY_FLAGS
+        u16 originalValue = cpu->regs.A;
+#endif
+        result = cpu->regs.A - operand - carry;
         cpu->regs.A = result & 0x00FF;
 
+#ifdef GB_CPU_LAZY_FLAGS
+        cpu->deferFlags(gb::FlagsOperation::Sub, originalValue, operand, carry, result);
+#else
         cpu->setFlag(gb::Z, cpu->regs.A == 0);
         cpu->setFlag(gb::N, 1);
-        cpu->setFlag(gb::H, static_cast<s16>((((result + operand + ((subCarryBit) ? cpu->regs.flags.C : 0)) & 0x0F) - (operand & 0x0F) - ((subCarryBit) ? cpu->regs.flags.C : 0))) < 0);
+        cpu->setFlag(gb::H, static_cast<s16>((((result + operand + carry) & 0x0F) - (operand & 0x0F) - carry)) < 0);
         cpu->setFlag(gb::C, result > 0xFF);
+#endif
     }
 
     template<BitwiseOperation OP_TYPE, OperandsType SRC_TYPE, typename Operand>
@@ -236,6 +249,9 @@ namespace gb
 
         cpu->regs.A = static_cast<u8>(result);
 
+#ifdef GB_CPU_LAZY_FLAGS
+        cpu->deferFlags((OP_TYPE == AND) ? gb::FlagsOperation::And : gb::FlagsOperation::OrXor, 0, 0, 0, result);
+#else
         cpu->setFlag(gb::Z, result == 0);
         cpu->setFlag(gb::N, 0);
 
@@ -245,6 +261,7 @@ namespace gb
             cpu->setFlag(gb::H, 0);
 
         cpu->setFlag(gb::C, 0);
+#endif
     }
 
     template<OperandsType SRC_TYPE, typename Operand>
@@ -261,10 +278,15 @@ namespace gb
 
         u16 result = cpu->regs.A - operand;
 
+#ifdef GB_CPU_LAZY_FLAGS
+        // Same flags as SUB, A just isn't written back
+        cpu->deferFlags(gb::FlagsOperation::Sub, cpu->regs.A, operand, 0, result);
+#else
         cpu->setFlag(gb::Z, result == 0);
         cpu->setFlag(gb::N, 1);
         cpu->setFlag(gb::H, (((result + operand) & 0x0F) - (operand & 0x0F)) < 0);
         cpu->setFlag(gb::C, result > 0xFF);
+#endif
     }
 
     template<OperandsType SRC_TYPE, typename Operand>
@@ -287,9 +309,13 @@ namespace gb
 
         if constexpr (std::is_same_v<Operand, u8> || SRC_TYPE == ADDRESS_PTR)
         {
+#ifdef GB_CPU_LAZY_FLAGS
+            cpu->deferFlags(gb::FlagsOperation::Inc, 0, 0, cpu->getFlag(gb::C), result);
+#else
             cpu->setFlag(gb::Z, (result & 0x00FF) == 0);
             cpu->setFlag(gb::N, 0);
             cpu->setFlag(gb::H, (((result - 1) & 0x0F) + 1) > 0x0F);
+#endif
         }
     }
 
@@ -313,9 +339,13 @@ namespace gb
 
         if (std::is_same_v<Operand, u8> || SRC_TYPE == ADDRESS_PTR)
         {
+#ifdef GB_CPU_LAZY_FLAGS
+            cpu->deferFlags(gb::FlagsOperation::Dec, 0, 0, cpu->getFlag(gb::C), result);
+#else
             cpu->setFlag(gb::Z, result == 0);
             cpu->setFlag(gb::N, 1);
             cpu->setFlag(gb::H, (((result + 1) & 0x0F) - 1) < 0);
+#endif
         }
     }
 
@@ -362,7 +392,7 @@ namespace gb
         cpu->setFlag(gb::H, 0);
     }
 
-    static auto NOP_() -> void
+    static auto NOP() -> void
     {
         // Does nothing
     }
@@ -395,7 +425,7 @@ namespace gb
             //printf("Discarded pending IME enable (delayed EI cancelled)\n");
         }
 
-        console->IME = false;
+        console->getCPU().IME = false;
 
         //printf("DI executed, IME is %d\n", console->IME);
 
@@ -405,8 +435,7 @@ namespace gb
 
     static auto JP(gb::SM83CPU* cpu, bool fromHL = false) -> void
     {
-        u16 address = (fromHL) ? cpu->regs.HL : cpu->read16(cpu->regs.PC);
-        cpu->regs.PC += 2;
+        u16 address = (fromHL) ? cpu->regs.HL : cpu->fetch16();
         cpu->regs.PC = address;
     }
 
@@ -415,8 +444,7 @@ namespace gb
     {
         u8 extraCycles = 0;
 
-        u16 address = cpu->read16(cpu->regs.PC);
-        cpu->regs.PC += 2;
+        u16 address = cpu->fetch16();
     
         if ((condition == JP_NZ && cpu->getFlag(Z) == 0)
             || (condition == JP_Z && cpu->getFlag(Z) == 1)
@@ -432,7 +460,7 @@ namespace gb
 
     static auto JR(gb::SM83CPU* cpu) -> void
     {
-        s8 relativeAddress = static_cast<s8>(cpu->read8(cpu->regs.PC++));
+        s8 relativeAddress = static_cast<s8>(cpu->fetch8());
         cpu->regs.PC += relativeAddress;
     }
 
@@ -441,7 +469,7 @@ namespace gb
     {
         u8 extraCycles = 0;
 
-        s8 relativeAddressByte = static_cast<s8>(cpu->read8(cpu->regs.PC++));
+        s8 relativeAddressByte = static_cast<s8>(cpu->fetch8());
 
         if ((condition == JP_NZ && cpu->getFlag(Z) == 0)
             || (condition == JP_Z && cpu->getFlag(Z) == 1)
@@ -450,6 +478,12 @@ namespace gb
         {
             extraCycles += 4;
             cpu->regs.PC += relativeAddressByte;
+
+#ifndef GB_CPU_M_CYCLE_ACCURATE
+            // Polling loops are a load, a test and this jump: 5 to 7 bytes
+            if (relativeAddressByte >= -7 && relativeAddressByte <= -5)
+                cpu->skipIdleLoop(cpu->regs.PC, cpu->regs.PC - relativeAddressByte - 2);
+#endif
         }
 
         return extraCycles;
@@ -457,8 +491,7 @@ namespace gb
 
     static auto CALL(gb::SM83CPU* cpu) -> void
     {
-        u16 newAddress = cpu->read16(cpu->regs.PC);
-        cpu->regs.PC += 2;
+        u16 newAddress = cpu->fetch16();
         PUSH(cpu, cpu->regs.PC);
         cpu->regs.PC = newAddress;
     }
@@ -468,8 +501,7 @@ namespace gb
     {
         u8 extraCycles = 0;
 
-        u16 newAddress = cpu->read16(cpu->regs.PC);
-        cpu->regs.PC += 2;
+        u16 newAddress = cpu->fetch16();
 
         if ((condition == JP_NZ && cpu->getFlag(Z) == 0)
             || (condition == JP_Z && cpu->getFlag(Z) == 1)
@@ -524,12 +556,12 @@ namespace gb
 
     static auto HALT(gb::SM83CPU* cpu) -> void
     {
-        //while (!cpu->checkPendingInterrupts());
-
-        //if (cpu->system->IME)
-        //{
-        //    // TODO
-        //}
+        // HALT bug: with IME off and an interrupt already pending the CPU doesn't halt at all
+        if (UNLIKELY(!cpu->IME && cpu->system->checkPendingInterrupts()))
+        {
+            cpu->executeHaltBug();
+            return;
+        }
 
         cpu->system->enterHaltMode();
         cpu->instructionCycles = 0;
@@ -537,9 +569,9 @@ namespace gb
         //printf("HALT mode entered\n");
     }
 
-    static auto STOP() -> void
+    static auto STOP(gb::SM83CPU* cpu) -> void
     {
-
+        cpu->system->enterStopMode();
     }
 
     static auto RLCA(gb::SM83CPU* cpu) -> void
@@ -548,10 +580,14 @@ namespace gb
         cpu->regs.A <<= 1;
         cpu->regs.A |= bit7;
 
+#ifdef GB_CPU_LAZY_FLAGS
+        cpu->deferFlags(gb::FlagsOperation::RotateA, 0, 0, bit7, 0);
+#else
         cpu->setFlag(gb::Z, 0);
         cpu->setFlag(gb::N, 0);
         cpu->setFlag(gb::H, 0);
         cpu->setFlag(gb::C, bit7);
+#endif
     }
 
     static auto RRCA(gb::SM83CPU* cpu) -> void
@@ -560,10 +596,14 @@ namespace gb
         cpu->regs.A >>= 1;
         cpu->regs.A |= (bit0 << 7);
 
+#ifdef GB_CPU_LAZY_FLAGS
+        cpu->deferFlags(gb::FlagsOperation::RotateA, 0, 0, bit0, 0);
+#else
         cpu->setFlag(gb::Z, 0);
         cpu->setFlag(gb::N, 0);
         cpu->setFlag(gb::H, 0);
         cpu->setFlag(gb::C, bit0);
+#endif
     }
 
     static auto RLA(gb::SM83CPU* cpu) -> void
@@ -572,10 +612,14 @@ namespace gb
         cpu->regs.A <<= 1;
         cpu->regs.A |= cpu->getFlag(gb::C);
 
+#ifdef GB_CPU_LAZY_FLAGS
+        cpu->deferFlags(gb::FlagsOperation::RotateA, 0, 0, bit7, 0);
+#else
         cpu->setFlag(gb::Z, 0);
         cpu->setFlag(gb::N, 0);
         cpu->setFlag(gb::H, 0);
         cpu->setFlag(gb::C, bit7);
+#endif
     }
 
     static auto RRA(gb::SM83CPU* cpu) -> void
@@ -584,10 +628,14 @@ namespace gb
         cpu->regs.A >>= 1;
         cpu->regs.A |= (cpu->getFlag(gb::C) << 7);
 
+#ifdef GB_CPU_LAZY_FLAGS
+        cpu->deferFlags(gb::FlagsOperation::RotateA, 0, 0, bit0, 0);
+#else
         cpu->setFlag(gb::Z, 0);
         cpu->setFlag(gb::N, 0);
         cpu->setFlag(gb::H, 0);
         cpu->setFlag(gb::C, bit0);
+#endif
     }
     
     template<typename Operand>
@@ -609,10 +657,14 @@ namespace gb
         else
             operand = value;
 
+#ifdef GB_CPU_LAZY_FLAGS
+        cpu->deferFlags(gb::FlagsOperation::Shift, 0, 0, bit7, static_cast<u8>(value));
+#else
         cpu->setFlag(gb::Z, value == 0);
         cpu->setFlag(gb::N, 0);
         cpu->setFlag(gb::H, 0);
         cpu->setFlag(gb::C, bit7);
+#endif
     }
 
     template<typename Operand>
@@ -634,10 +686,14 @@ namespace gb
         else
             operand = value;
 
+#ifdef GB_CPU_LAZY_FLAGS
+        cpu->deferFlags(gb::FlagsOperation::Shift, 0, 0, bit0, static_cast<u8>(value));
+#else
         cpu->setFlag(gb::Z, value == 0);
         cpu->setFlag(gb::N, 0);
         cpu->setFlag(gb::H, 0);
         cpu->setFlag(gb::C, bit0);
+#endif
     }
 
     template<typename Operand>
@@ -659,10 +715,14 @@ namespace gb
         else
             operand = value;
 
+#ifdef GB_CPU_LAZY_FLAGS
+        cpu->deferFlags(gb::FlagsOperation::Shift, 0, 0, bit7, static_cast<u8>(value));
+#else
         cpu->setFlag(gb::Z, value == 0);
         cpu->setFlag(gb::N, 0);
         cpu->setFlag(gb::H, 0);
         cpu->setFlag(gb::C, bit7);
+#endif
     }
 
     template<typename Operand>
@@ -684,10 +744,14 @@ namespace gb
         else
             operand = value;
 
+#ifdef GB_CPU_LAZY_FLAGS
+        cpu->deferFlags(gb::FlagsOperation::Shift, 0, 0, bit0, static_cast<u8>(value));
+#else
         cpu->setFlag(gb::Z, value == 0);
         cpu->setFlag(gb::N, 0);
         cpu->setFlag(gb::H, 0);
         cpu->setFlag(gb::C, bit0);
+#endif
     }
 
     template<typename Operand>
@@ -708,10 +772,14 @@ namespace gb
         else
             operand = value;
 
+#ifdef GB_CPU_LAZY_FLAGS
+        cpu->deferFlags(gb::FlagsOperation::Shift, 0, 0, bit7, static_cast<u8>(value));
+#else
         cpu->setFlag(gb::Z, value == 0);
         cpu->setFlag(gb::N, 0);
         cpu->setFlag(gb::H, 0);
         cpu->setFlag(gb::C, bit7);
+#endif
     }
 
     template<typename Operand>
@@ -732,10 +800,14 @@ namespace gb
         else
             operand = static_cast<u8>(value);
 
+#ifdef GB_CPU_LAZY_FLAGS
+        cpu->deferFlags(gb::FlagsOperation::Shift, 0, 0, bit0, static_cast<u8>(value));
+#else
         cpu->setFlag(gb::Z, value == 0);
         cpu->setFlag(gb::N, 0);
         cpu->setFlag(gb::H, 0);
         cpu->setFlag(gb::C, bit0);
+#endif
     }
 
     template<typename Operand>
@@ -755,10 +827,14 @@ namespace gb
         else
             operand = value;
 
+#ifdef GB_CPU_LAZY_FLAGS
+        cpu->deferFlags(gb::FlagsOperation::Shift, 0, 0, 0, static_cast<u8>(value));
+#else
         cpu->setFlag(gb::Z, value == 0);
         cpu->setFlag(gb::N, 0);
         cpu->setFlag(gb::H, 0);
         cpu->setFlag(gb::C, 0);
+#endif
     }
 
     template<typename Operand>
@@ -779,10 +855,14 @@ namespace gb
         else
             operand = value;
 
+#ifdef GB_CPU_LAZY_FLAGS
+        cpu->deferFlags(gb::FlagsOperation::Shift, 0, 0, bit0, static_cast<u8>(value));
+#else
         cpu->setFlag(gb::Z, value == 0);
         cpu->setFlag(gb::N, 0);
         cpu->setFlag(gb::H, 0);
         cpu->setFlag(gb::C, bit0);
+#endif
     }
 
     template<u8 Bit, typename Operand>
@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2023 pabletefest
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#pragma once
+#include "rom_bank_provider.h"
+
+#include <string>
+
+#if !defined(ESP32) && (defined(__unix__) || defined(__APPLE__))
+    #define GB_HAS_MAPPED_FILE_ROM
+#endif
+
+#ifdef GB_HAS_MAPPED_FILE_ROM
+
+namespace gb
+{
+    // ROM file mapped read-only into the address space (host builds). Banks are served straight from the
+    // mapping, nothing is copied at load time and processes running the same ROM share its page cache pages.
+    class MappedFileROMBankProvider : public ROMBankProvider
+    {
+    public:
+        MappedFileROMBankProvider(const std::string& path, u32 romSize);
+        ~MappedFileROMBankProvider() override;
+
+        // Inherited via ROMBankProvider
+        virtual auto loadBank(u8 slot, u16 bank) -> const u8* override;
+        virtual auto getSize() const -> u32 override { return romSize; }
+
+        // False if the file couldn't be mapped or is shorter than the header ROM size (touching
+        // the mapping past the end of the file would fault), the caller should fall back to reading it
+        inline auto isMapped() const -> bool { return mappedData != nullptr; }
+
+    private:
+        const u8* mappedData = nullptr;
+        u32 romSize = 0;
+    };
+}
+
+#endif
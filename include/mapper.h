@@ -1,18 +1,59 @@
+/*
+ * Copyright (C) 2023 pabletefest
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
 #pragma once
 #include "emu_typedefs.h"
+#include "util_funcs.h"
+
+#include <array>
 
 namespace gb
 {
+    // State shared by every cartridge mapper. Mappers are plain classes stored by value in GamePak's
+    // std::variant, so the concrete type is resolved once when the cartridge is loaded and no call is virtual.
     class Mapper
     {
     public:
-        Mapper(u8 numROMBanks);
-        virtual ~Mapper() = default;
+        Mapper(u16 numROMBanks, u8 numRAMBanks);
+        ~Mapper() = default;
+
+        // Offset in the ROM image of the bank visible in 0x0000-0x3FFF (slot 0) or 0x4000-0x7FFF (slot 1)
+        inline auto getROMBankOffset(u8 slot) const -> u32 { return romBankOffsets[slot]; }
+        inline auto getROMBank(u8 slot) const -> u16 { return static_cast<u16>(romBankOffsets[slot] / convertKBToBytes(16)); }
+
+        // Offset in the external RAM of the 8KB bank visible in 0xA000-0xBFFF
+        inline auto getRAMBankOffset() const -> u32 { return ramBankOffset; }
+        inline auto isRAMEnabled() const -> bool { return ramEnabled && ramBankSelected && nRAMBanks > 0; }
+
+        // Registers overlaid on 0xA000-0xBFFF in place of RAM (e.g. MBC3 RTC). Mappers providing them hide these
+        // defaults, the call is resolved statically through the variant.
+        inline auto readRAMRegister(u16 addr, u8& data) -> bool { return false; }
+        inline auto writeRAMRegister(u16 addr, u8 data) -> bool { return false; }
+
+        template <typename Visitor>
+        auto serialize(Visitor& state) -> void
+        {
+            state.value(romBankOffsets);
+            state.value(ramBankOffset);
+            state.value(ramEnabled);
+            state.value(ramBankSelected);
+        }
+
+    protected:
+        // Bank switches update the cached offsets, so reads never recompute them
+        auto setROMBank(u8 slot, u16 bank) -> void;
+        auto setRAMBank(u8 bank) -> void;
 
-        virtual auto mapRead(u16 addr, u16& mapped_addr) -> bool = 0;
-        virtual auto mapWrite(u16 addr, u16& mapped_addr, u8 data) -> bool = 0; // data is provided for mappers that need registers
-    
     protected:
-        u8 nROMBanks = 0;
+        u16 nROMBanks = 0;
+        u8 nRAMBanks = 0;
+        std::array<u32, 2> romBankOffsets = { 0, convertKBToBytes(16) };
+        u32 ramBankOffset = 0;
+        bool ramEnabled = false;
+        bool ramBankSelected = true; // False while a register is selected in the RAM window
     };
-}
\ No newline at end of file
+}
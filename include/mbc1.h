@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2023 pabletefest
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#pragma once
+#include "mapper.h"
+
+namespace gb
+{
+    // MBC1: 5-bit ROM bank register extended by a 2-bit register that selects either the upper
+    // ROM bank bits or, in banking mode 1, the RAM bank (and the bank mapped in 0x0000-0x3FFF)
+    class MBC1Mapper : public Mapper
+    {
+    public:
+        MBC1Mapper(u16 numROMBanks, u8 numRAMBanks);
+        ~MBC1Mapper() = default;
+
+        auto writeRegister(u16 addr, u8 data) -> void;
+
+        template <typename Visitor>
+        auto serialize(Visitor& state) -> void
+        {
+            Mapper::serialize(state);
+            state.value(romBankLowBits);
+            state.value(bankHighBits);
+            state.value(bankingMode);
+        }
+
+    private:
+        auto updateBanks() -> void;
+
+    private:
+        u8 romBankLowBits = 0x01; // 0x2000-0x3FFF
+        u8 bankHighBits = 0x00; // 0x4000-0x5FFF
+        u8 bankingMode = 0x00; // 0x6000-0x7FFF
+    };
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2023 pabletefest
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#pragma once
+#include "mapper.h"
+
+namespace gb
+{
+    // MBC3: 7-bit ROM bank, 4 RAM banks and an optional real time clock whose registers (0x08-0x0C)
+    // are selected through the RAM bank register and read from the RAM window
+    class MBC3Mapper : public Mapper
+    {
+    public:
+        static constexpr u32 RTC_CYCLES_PER_SECOND = 4194304;
+
+        // Enough to persist the clock along with the battery RAM or a save state
+        struct RTCState
+        {
+            u8 registers[5]; // Seconds, minutes, hours, day counter low, day counter high/halt/carry
+            u8 latchedRegisters[5];
+            u32 subSecondCycles;
+            s64 hostTimestamp; // Host wall-clock seconds when the state was taken
+        };
+
+    public:
+        MBC3Mapper(u16 numROMBanks, u8 numRAMBanks, bool hasRTC);
+        ~MBC3Mapper() = default;
+
+        auto writeRegister(u16 addr, u8 data) -> void;
+
+        auto readRAMRegister(u16 addr, u8& data) -> bool;
+        auto writeRAMRegister(u16 addr, u8 data) -> bool;
+
+        // The clock is only brought up to date from this counter when its registers are accessed
+        inline auto setCycleCounter(const u64* counter) -> void { cycleCounter = counter; lastSyncTimestamp = counter ? *counter : 0; }
+
+        inline auto hasClock() const -> bool { return hasRTC; }
+
+        auto saveRTCState() -> RTCState;
+        // Emulated time catches up with the host time passed since the state was taken unless the clock is halted
+        auto loadRTCState(const RTCState& state) -> void;
+
+        // The clock sync timestamp is stored as is, it stays consistent with the restored console cycle counter
+        template <typename Visitor>
+        auto serialize(Visitor& state) -> void
+        {
+            Mapper::serialize(state);
+            state.value(romBank);
+            state.value(ramBankOrRTCSelect);
+            state.value(latchRegister);
+            state.value(rtcRegisters);
+            state.value(rtcLatchedRegisters);
+            state.value(subSecondCycles);
+            state.value(lastSyncTimestamp);
+        }
+
+    private:
+        auto syncRTC() -> void;
+        auto advanceRTC(u64 seconds) -> void;
+
+    private:
+        enum RTCRegister : u8 { Seconds, Minutes, Hours, DayLow, DayHigh };
+
+        u8 romBank = 0x01;
+        u8 ramBankOrRTCSelect = 0x00;
+        u8 latchRegister = 0xFF;
+
+        bool hasRTC = false;
+        u8 rtcRegisters[5] = {};
+        u8 rtcLatchedRegisters[5] = {};
+        u32 subSecondCycles = 0;
+
+        const u64* cycleCounter = nullptr;
+        u64 lastSyncTimestamp = 0;
+    };
+}
@@ -0,0 +1,32 @@
+/*
+ * Copyright (C) 2023 pabletefest
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#pragma once
+#include "mapper.h"
+
+namespace gb
+{
+    // MBC5: 9-bit ROM bank (up to 8MB, bank 0 can be mapped in 0x4000-0x7FFF too) and 4-bit RAM bank
+    class MBC5Mapper : public Mapper
+    {
+    public:
+        MBC5Mapper(u16 numROMBanks, u8 numRAMBanks);
+        ~MBC5Mapper() = default;
+
+        auto writeRegister(u16 addr, u8 data) -> void;
+
+        template <typename Visitor>
+        auto serialize(Visitor& state) -> void
+        {
+            Mapper::serialize(state);
+            state.value(romBank);
+        }
+
+    private:
+        u16 romBank = 0x001;
+    };
+}
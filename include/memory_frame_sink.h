@@ -0,0 +1,38 @@
+/*
+ * Copyright (C) 2023 pabletefest
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#pragma once
+#include "frame_sink.h"
+
+#include <array>
+
+namespace gb
+{
+    // Headless sink: keeps a RGB565 frame in RAM and ignores presentation/text requests
+    class MemoryFrameSink : public FrameSink
+    {
+    public:
+        MemoryFrameSink() = default;
+        ~MemoryFrameSink() override = default;
+
+        // Inherited via FrameSink
+        virtual auto getColorDepth() -> u8 override { return 16; }
+        virtual auto drawPixel(s32 x, s32 y, u32 color) -> void override;
+        virtual auto readPixelValue(s32 x, s32 y) -> u16 override;
+        virtual auto getPixelsBufferData() -> u8* override;
+
+        virtual auto presentFrame() -> void override;
+        virtual auto printText(const std::string& text, u8 font, u8 datum) -> void override;
+        virtual auto printText(const std::string& text, u16 x, u16 y, u8 font, u8 datum) -> void override;
+
+        inline auto getFramesPresented() const -> u32 { return framesPresented; }
+
+    private:
+        std::array<u16, GB_PIXELS_WIDTH * GB_PIXELS_HEIGHT> pixels = {};
+        u32 framesPresented = 0;
+    };
+}
@@ -0,0 +1,29 @@
+/*
+ * Copyright (C) 2023 pabletefest
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#pragma once
+#include "rom_bank_provider.h"
+
+#include <vector>
+
+namespace gb
+{
+    // Whole ROM image kept in RAM, banks are just offsets into it
+    class MemoryROMBankProvider : public ROMBankProvider
+    {
+    public:
+        MemoryROMBankProvider(std::vector<u8>&& romData);
+        ~MemoryROMBankProvider() override = default;
+
+        // Inherited via ROMBankProvider
+        virtual auto loadBank(u8 slot, u16 bank) -> const u8* override;
+        virtual auto getSize() const -> u32 override { return static_cast<u32>(vROMMemory.size()); }
+
+    private:
+        std::vector<u8> vROMMemory;
+    };
+}
@@ -13,11 +13,9 @@ namespace gb
     class NoMBCMapper : public Mapper
     {
     public:
-        NoMBCMapper(u8 numROMBanks);
-        ~NoMBCMapper() override = default;
+        NoMBCMapper(u16 numROMBanks, u8 numRAMBanks);
+        ~NoMBCMapper() = default;
 
-        // Inherited via Mapper
-        virtual auto mapRead(u16 addr, u16& mapped_addr) -> bool override;
-        virtual auto mapWrite(u16 addr, u16& mapped_addr, u8 data) -> bool override;
+        auto writeRegister(u16 addr, u8 data) -> void;
     };
 }
@@ -0,0 +1,39 @@
+/*
+ * Copyright (C) 2023 pabletefest
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#pragma once
+#include "rom_bank_provider.h"
+
+#ifdef ESP32
+
+#include <esp_partition.h>
+
+namespace gb
+{
+    // ROM flashed into a raw data partition (see partitions_rom.csv) and mapped through the flash cache,
+    // banks are read in place so no heap is used and nothing is copied at startup.
+    // The host counterpart is MappedFileROMBankProvider.
+    class PartitionROMBankProvider : public ROMBankProvider
+    {
+    public:
+        PartitionROMBankProvider(const char* label);
+        ~PartitionROMBankProvider() override;
+
+        // Inherited via ROMBankProvider
+        virtual auto loadBank(u8 slot, u16 bank) -> const u8* override;
+        virtual auto getSize() const -> u32 override { return partitionSize; }
+
+        inline auto isMapped() const -> bool { return mappedData != nullptr; }
+
+    private:
+        const u8* mappedData = nullptr;
+        u32 partitionSize = 0;
+        spi_flash_mmap_handle_t mapHandle = 0;
+    };
+}
+
+#endif
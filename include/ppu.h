@@ -8,11 +8,9 @@
 #pragma once
 #include "emu_typedefs.h"
 #include "util_funcs.h"
+#include "frame_sink.h"
 #include <array>
-
-#ifdef ESP32
-    #include <TFT_eSPI.h>
-#endif
+#include <string>
 
 namespace gb
 {
@@ -44,18 +42,48 @@ namespace gb
         auto write(u16 address, u8 data) -> void;
 
         auto reset() -> void;
-        auto clock() -> void;
+
+        // Scanline state machine, driven by the events the PPU schedules for itself
+        auto onMode3Event(u64 timestamp) -> void;
+        auto onHBlankEvent() -> void;
+        auto onNewLineEvent(u64 timestamp) -> void;
+
+        // When the next OAM scan (end of mode 2) reads OAM, Scheduler::NO_EVENT with the LCD off
+        auto getNextOAMScanTimestamp() const -> u64;
 
         // inline auto getPixelsBufferData() const -> const PPU::Pixel* { return pixelsBuffer.data(); }
         // inline auto getPixelsBuffer() -> std::array<Pixel, 160 * 144>& { return pixelsBuffer; }
         auto getPixelsBufferData() -> u8*;
-        auto getSpriteBuffer() -> TFT_eSprite& { return screenSprite; }
+        inline auto getFrameSink() -> FrameSink& { return *screen; }
+        auto setFrameSink(Scope<FrameSink> sink) -> void;
 
         auto drawFrameToDisplay()-> void;
         auto printTextToDisplay(const std::string& text, u8 font = 1, u8 datum = TL_DATUM) -> void;
         auto printTextToDisplay(const std::string& text, u16 x, u16 y, u8 font = 1, u8 datum = TL_DATUM) -> void;
-        
+
+        // The frame sink contents aren't part of the state, the next frame redraws them
+        template <typename Visitor>
+        auto serialize(Visitor& state) -> void
+        {
+            state.bytes(VRAM.data(), static_cast<u32>(VRAM.size()));
+            state.value(OAM);
+            state.value(scanlineValidSprites);
+            state.value(spritesFound);
+            state.value(LY);
+            state.value(LYC);
+            state.value(lastMode3Dot);
+            state.value(SCX);
+            state.value(SCY);
+            state.value(LCDControl);
+            state.value(LCDStatus);
+            state.value(bgPaletteData);
+            state.value(obj0PaletteData);
+            state.value(obj1PaletteData);
+        }
+
     private:
+        auto startScanline(u64 timestamp) -> void;
+        auto stopScanlineEvents() -> void;
         auto checkAndRaiseStatInterrupts() -> void;
         auto renderBackground() -> void;
         auto renderWindow() -> void;
@@ -67,8 +95,7 @@ namespace gb
         bool frameCompleted = false;
 
     private:
-        TFT_eSPI display;
-        TFT_eSprite screenSprite = TFT_eSprite(&display);
+        Scope<FrameSink> screen;
         // std::array<Pixel, 160 * 144> pixelsBuffer = {};
         std::array<u8, 8_KB> VRAM = {};
         //std::array<u8, 160> OAM = {};
@@ -87,8 +114,6 @@ namespace gb
 
         u8 LY = 0x00;
         u8 LYC = 0x00;
-        u16 currentDot = 0x00;
-        u16 remainingDots = 456; // Max dots per scanline
         const u16 totalDotsPerScanline = 456;
         u16 lastMode3Dot = 0;
         u8 SCX = 0x00;
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2023 pabletefest
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#pragma once
+#include "emu_typedefs.h"
+
+#include <vector>
+
+// Bytes of history kept by default (the latest full state is stored aside)
+#ifndef GB_REWIND_BUFFER_SIZE
+    #ifdef ESP32
+        #define GB_REWIND_BUFFER_SIZE (64 * 1024)
+    #else
+        #define GB_REWIND_BUFFER_SIZE (4 * 1024 * 1024)
+    #endif
+#endif
+
+#ifndef GB_REWIND_FRAMES_PER_SNAPSHOT
+    #define GB_REWIND_FRAMES_PER_SNAPSHOT 30
+#endif
+
+namespace gb
+{
+    class GBConsole;
+
+    // Rewind history built on save states. The newest snapshot is kept whole and every older one is stored as a
+    // backward delta (XOR against the next one, zero runs RLE encoded) in a fixed size ring buffer, the oldest
+    // deltas being dropped when it fills up.
+    class RewindBuffer
+    {
+    public:
+        struct Stats
+        {
+            u32 snapshotsStored = 0;
+            u32 bytesUsed = 0;
+            u32 lastSnapshotBytes = 0; // Encoded delta size
+            u32 lastCaptureMicros = 0;
+            u32 maxCaptureMicros = 0;
+            u64 captures = 0;
+            u64 totalSnapshotBytes = 0;
+        };
+
+    public:
+        RewindBuffer(u32 capacityBytes = GB_REWIND_BUFFER_SIZE, u16 framesPerSnapshot = GB_REWIND_FRAMES_PER_SNAPSHOT);
+        ~RewindBuffer() = default;
+
+        // Call once per emulated frame, a snapshot is taken every framesPerSnapshot frames. Returns true if it was.
+        auto onFrameCompleted(GBConsole& console) -> bool;
+        auto capture(GBConsole& console) -> void;
+
+        // Restores the newest snapshot and drops it, so repeated calls walk back in time. False once history is empty.
+        auto stepBack(GBConsole& console) -> bool;
+
+        auto clear() -> void;
+
+        inline auto getStats() const -> const Stats& { return stats; }
+        inline auto getLatestState() const -> const std::vector<u8>& { return latestState; }
+
+    private:
+        struct Record
+        {
+            u32 offset;
+            u32 size;
+        };
+
+        auto encodeDelta(const std::vector<u8>& from, const std::vector<u8>& to) -> void;
+        auto applyDelta(std::vector<u8>& state) -> void;
+
+        auto pushRecord(const std::vector<u8>& data) -> void;
+        auto dropOldestRecord() -> void;
+        auto popNewestRecord(std::vector<u8>& data) -> void;
+
+    private:
+        static constexpr u32 MAX_RECORDS = 1024;
+
+        u16 framesPerSnapshot = 0;
+        u16 framesSinceSnapshot = 0;
+
+        std::vector<u8> latestState;
+        bool hasLatestState = false;
+        std::vector<u8> capturedState;
+        std::vector<u8> deltaScratch;
+
+        // Ring of encoded deltas, records hold their position (wrapping around the end) oldest first
+        std::vector<u8> storage;
+        u32 storageHead = 0;
+        u32 storageUsed = 0;
+        std::vector<Record> records;
+        u32 firstRecord = 0;
+        u32 recordCount = 0;
+
+        Stats stats;
+    };
+}
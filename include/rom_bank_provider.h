@@ -0,0 +1,42 @@
+/*
+ * Copyright (C) 2023 pabletefest
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#pragma once
+#include "emu_typedefs.h"
+#include "util_funcs.h"
+
+#define GB_ROM_BANK_SIZE convertKBToBytes(16)
+
+namespace gb
+{
+    // Source of the cartridge ROM contents, fetched in 16KB banks. Small ROMs stay fully resident
+    // (see MemoryROMBankProvider) while big ones are read on demand (see FileROMBankProvider).
+    class ROMBankProvider
+    {
+    public:
+        virtual ~ROMBankProvider() = default;
+
+        // Data of the bank shown in the given mapper slot (0x0000-0x3FFF or 0x4000-0x7FFF),
+        // it stays valid until that slot is loaded with another bank
+        virtual auto loadBank(u8 slot, u16 bank) -> const u8* = 0;
+
+        virtual auto getSize() const -> u32 = 0;
+
+        // Bank switches served from memory (hits), read from storage (misses) and banks dropped to make room
+        struct Stats
+        {
+            u32 hits = 0;
+            u32 misses = 0;
+            u32 evictions = 0;
+        };
+
+        inline auto getStats() const -> const Stats& { return stats; }
+
+    protected:
+        Stats stats;
+    };
+}
@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2023 pabletefest
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#pragma once
+#include "emu_typedefs.h"
+
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+namespace gb
+{
+    // Save state blob: header followed by every component's fields in the order their serialize() visits them.
+    // Bump the version whenever a serialize() changes, states of other versions are rejected.
+    static constexpr u8 SAVE_STATE_MAGIC[4] = { 'F', 'B', 'S', 'T' };
+    static constexpr u16 SAVE_STATE_VERSION = 3;
+
+    struct SaveStateHeader
+    {
+        u8 magic[4];
+        u16 version;
+        u16 romGlobalChecksum; // States only load on the ROM they were taken from
+    };
+
+    // Components describe their state once in a `template <typename Visitor> auto serialize(Visitor& state)`
+    // member calling value() for fields and bytes() for bulk memory, both visitors below run through it.
+
+    // Size of the state without copying anything, used to validate blobs before loading them
+    class StateSizeCounter
+    {
+    public:
+        static constexpr bool loading = false;
+
+        template <typename T>
+        inline auto value(const T& field) -> void { size += sizeof(T); }
+        inline auto bytes(const void* data, u32 count) -> void { size += count; }
+
+        inline auto getSize() const -> u32 { return size; }
+
+    private:
+        u32 size = 0;
+    };
+
+    class StateWriter
+    {
+    public:
+        static constexpr bool loading = false;
+
+        StateWriter(std::vector<u8>& buffer) : buffer(buffer) {}
+
+        template <typename T>
+        inline auto value(const T& field) -> void
+        {
+            static_assert(std::is_trivially_copyable<T>::value, "Only plain data can be copied into a save state");
+            bytes(&field, sizeof(T));
+        }
+
+        inline auto bytes(const void* data, u32 size) -> void
+        {
+            size_t offset = buffer.size();
+            buffer.resize(offset + size);
+            std::memcpy(buffer.data() + offset, data, size);
+        }
+
+    private:
+        std::vector<u8>& buffer;
+    };
+
+    class StateReader
+    {
+    public:
+        static constexpr bool loading = true;
+
+        StateReader(const u8* data, u32 size) : data(data), size(size) {}
+
+        template <typename T>
+        inline auto value(T& field) -> void
+        {
+            static_assert(std::is_trivially_copyable<T>::value, "Only plain data can be copied from a save state");
+            bytes(&field, sizeof(T));
+        }
+
+        inline auto bytes(void* destination, u32 count) -> void
+        {
+            if (failed || count > size - offset)
+            {
+                failed = true;
+                return;
+            }
+
+            std::memcpy(destination, data + offset, count);
+            offset += count;
+        }
+
+        // Truncated blob, or extra data left over once everything was read
+        inline auto isValid() const -> bool { return !failed && offset == size; }
+
+    private:
+        const u8* data = nullptr;
+        u32 size = 0;
+        u32 offset = 0;
+        bool failed = false;
+    };
+}
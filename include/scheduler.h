@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2023 pabletefest
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#pragma once
+#include "emu_typedefs.h"
+
+#include <array>
+#include <limits>
+
+namespace gb
+{
+    enum class EventType : u8
+    {
+        PPUMode3,       // OAM search finished (mode 2 -> 3)
+        PPUHBlank,      // Scanline rendered (mode 3 -> 0)
+        PPUNewLine,     // LY increment, LYC compare and mode 2 or VBlank entry
+        TimerOverflow,  // TIMA wraps around and gets reloaded from TMA
+        OAMDMAEnd,      // Last of the 160 bytes of an OAM DMA copied, the CPU gets the whole bus back
+        Count
+    };
+
+    // Central event queue. Every event type owns one slot holding the absolute T-cycle timestamp
+    // it's due at, so components compute their next deadline instead of polling every cycle.
+    class Scheduler
+    {
+    public:
+        static constexpr u64 NO_EVENT = std::numeric_limits<u64>::max();
+
+        Scheduler();
+        ~Scheduler() = default;
+
+        auto schedule(EventType type, u64 timestamp) -> void;
+        auto cancel(EventType type) -> void;
+        auto reset() -> void;
+
+        inline auto getDeadline(EventType type) const -> u64 { return deadlines[static_cast<u8>(type)]; }
+        inline auto getNextDeadline() const -> u64 { return nextDeadline; }
+
+        // Removes the earliest event due at or before currentTimestamp, returns false if there is none
+        auto popDueEvent(u64 currentTimestamp, EventType& type, u64& timestamp) -> bool;
+
+        // Deadlines are absolute timestamps, restoring them along with the cycle counter resumes every event
+        template <typename Visitor>
+        auto serialize(Visitor& state) -> void
+        {
+            state.value(deadlines);
+            state.value(nextDeadline);
+        }
+
+    private:
+        auto updateNextDeadline() -> void;
+
+    private:
+        std::array<u64, static_cast<u8>(EventType::Count)> deadlines;
+        u64 nextDeadline = NO_EVENT;
+    };
+}
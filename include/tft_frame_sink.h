@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2023 pabletefest
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#pragma once
+#include "frame_sink.h"
+
+#ifdef ESP32
+
+namespace gb
+{
+    // ILI9486 TFT display driven by TFT_eSPI, frames are composed in a sprite and pushed at the end
+    class TFTFrameSink : public FrameSink
+    {
+    public:
+        TFTFrameSink(const u16* palette, u8 paletteSize);
+        ~TFTFrameSink() override = default;
+
+        // Inherited via FrameSink
+        virtual auto getColorDepth() -> u8 override { return screenSprite.getColorDepth(); }
+        virtual auto drawPixel(s32 x, s32 y, u32 color) -> void override { screenSprite.drawPixel(x, y, color); }
+        virtual auto readPixelValue(s32 x, s32 y) -> u16 override { return screenSprite.readPixelValue(x, y); }
+        virtual auto getPixelsBufferData() -> u8* override;
+
+        virtual auto presentFrame() -> void override;
+        virtual auto printText(const std::string& text, u8 font, u8 datum) -> void override;
+        virtual auto printText(const std::string& text, u16 x, u16 y, u8 font, u8 datum) -> void override;
+
+        auto getSpriteBuffer() -> TFT_eSprite& { return screenSprite; }
+
+    private:
+        TFT_eSPI display;
+        TFT_eSprite screenSprite = TFT_eSprite(&display);
+    };
+}
+
+#endif
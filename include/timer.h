@@ -21,13 +21,31 @@ namespace gb
         auto read(u16 address) -> u8;
         auto write(u16 address, u8 data) -> void;
 
-        auto clock() -> void;
+        auto onOverflowEvent(u64 timestamp) -> void;
 
-        inline auto setDIVtoSkippedBootromValue() -> void { internalRegisterDIV = 0xABCC; }
+        auto setDIVtoSkippedBootromValue() -> void;
+
+        template <typename Visitor>
+        auto serialize(Visitor& state) -> void
+        {
+            state.value(lastSyncTimestamp);
+            state.value(internalRegisterDIV);
+            state.value(timerCounter);
+            state.value(timerModulo);
+            state.value(timerControl);
+        }
+
+    private:
+        auto sync(u64 timestamp) -> void;
+        auto addTIMATicks(u64 ticks) -> void;
+        auto watchedBitIndex() const -> u8;
+        auto scheduleOverflow() -> void;
 
     private:
         GBConsole* system;
 
+        // DIV and TIMA are brought up to date lazily from the elapsed cycles since the last sync
+        u64 lastSyncTimestamp = 0;
         u16 internalRegisterDIV = 0x0000;
 
         u8 timerCounter = 0x00; // TIMA
@@ -46,8 +64,5 @@ namespace gb
         }timerControl = { };
 
         //u8 timerControl = 0x00; // TAC
-
-        u8 cyclesElapsed = 0x00;
-        u8 lastANDresult = 0x00;
     };
 }
@@ -21,6 +21,19 @@
 #define INLINE inline
 #endif
 
+#ifdef _WIN32
+#define ALWAYS_INLINE __forceinline
+#else
+#define ALWAYS_INLINE inline __attribute__((always_inline))
+#endif
+
+// Branch hint for edge cases, so the compiler lays the common path out as the fall through
+#ifdef _WIN32
+#define UNLIKELY(condition) (condition)
+#else
+#define UNLIKELY(condition) __builtin_expect(!!(condition), 0)
+#endif
+
 constexpr INLINE u32 convertKBToBytes(u32 KB) { return static_cast<u32>(KB) * 1024; }
 
 template<typename T>
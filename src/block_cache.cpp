@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2023 pabletefest
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#include "block_cache.h"
+#include "gb.h"
+
+static_assert((GB_BLOCK_CACHE_SIZE & (GB_BLOCK_CACHE_SIZE - 1)) == 0, "GB_BLOCK_CACHE_SIZE must be a power of two");
+static_assert(GB_BLOCK_MAX_INSTRUCTIONS <= 255, "Block instruction count is stored in a byte");
+
+// Bytes taken by each opcode, as the interpreter fetches them (STOP doesn't consume its padding byte)
+static constexpr u8 instructionsLengthTable[256] = {
+    1, 3, 1, 1, 1, 1, 2, 1, 3, 1, 1, 1, 1, 1, 2, 1,
+    1, 3, 1, 1, 1, 1, 2, 1, 2, 1, 1, 1, 1, 1, 2, 1,
+    2, 3, 1, 1, 1, 1, 2, 1, 2, 1, 1, 1, 1, 1, 2, 1,
+    2, 3, 1, 1, 1, 1, 2, 1, 2, 1, 1, 1, 1, 1, 2, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 3, 3, 3, 1, 2, 1, 1, 1, 3, 2, 3, 3, 2, 1,
+    1, 1, 3, 1, 3, 1, 2, 1, 1, 1, 3, 1, 3, 1, 2, 1,
+    2, 1, 1, 1, 1, 1, 2, 1, 2, 1, 3, 1, 1, 1, 2, 1,
+    2, 1, 1, 1, 1, 1, 2, 1, 2, 1, 3, 1, 1, 1, 2, 1,
+};
+
+// Instructions after which execution may not continue at the next address: jumps, calls, returns,
+// restarts, HALT, STOP and the unused opcodes
+static constexpr auto endsBlock(u8 opcode) -> bool
+{
+    switch (opcode)
+    {
+    case 0x10: case 0x18: case 0x20: case 0x28: case 0x30: case 0x38: case 0x76:
+    case 0xC0: case 0xC2: case 0xC3: case 0xC4: case 0xC7: case 0xC8: case 0xC9: case 0xCA: case 0xCC: case 0xCD: case 0xCF:
+    case 0xD0: case 0xD2: case 0xD3: case 0xD4: case 0xD7: case 0xD8: case 0xD9: case 0xDA: case 0xDB: case 0xDC: case 0xDD: case 0xDF:
+    case 0xE3: case 0xE4: case 0xE7: case 0xE9: case 0xEB: case 0xEC: case 0xED: case 0xEF:
+    case 0xF4: case 0xF7: case 0xFC: case 0xFD: case 0xFF:
+        return true;
+    default:
+        return false;
+    }
+}
+
+gb::BlockCache::BlockCache()
+    : blocks(GB_BLOCK_CACHE_SIZE)
+{
+}
+
+auto gb::BlockCache::getBlock(GBConsole& bus, u16 bank, u16 address) -> const Block*
+{
+    // Consecutive banks and addresses spread over the whole table
+    Block& block = blocks[(address ^ (bank * 0x9E5u)) & (GB_BLOCK_CACHE_SIZE - 1)];
+
+    if (block.bank == bank && block.startAddress == address && block.count > 0)
+    {
+        stats.hits++;
+        return &block;
+    }
+
+    stats.misses++;
+    decode(bus, block, bank, address);
+
+    return block.count > 0 ? &block : nullptr;
+}
+
+auto gb::BlockCache::clear() -> void
+{
+    for (Block& block : blocks)
+    {
+        block.bank = NO_BANK;
+        block.count = 0;
+    }
+}
+
+auto gb::BlockCache::decode(GBConsole& bus, Block& block, u16 bank, u16 address) -> void
+{
+    // Blocks never leave the region their bank is mapped in, the next one may hold another bank
+    u32 regionEnd = (bank == BOOT_ROM_BANK) ? 0x0100 : (address < 0x4000 ? 0x4000 : 0x8000);
+    u32 pc = address;
+
+    block.bank = bank;
+    block.startAddress = address;
+    block.count = 0;
+
+    while (block.count < GB_BLOCK_MAX_INSTRUCTIONS)
+    {
+        u8 opcode = bus.read8(static_cast<u16>(pc));
+        u8 length = instructionsLengthTable[opcode];
+
+        if (pc + length > regionEnd)
+            break;
+
+        DecodedInstruction& instruction = block.instructions[block.count++];
+        instruction.opcode = opcode;
+        instruction.length = length;
+        instruction.operand[0] = (length >= 2) ? bus.read8(static_cast<u16>(pc + 1)) : 0;
+        instruction.operand[1] = (length == 3) ? bus.read8(static_cast<u16>(pc + 2)) : 0;
+
+        pc += length;
+
+        if (endsBlock(opcode))
+            break;
+    }
+}
@@ -8,23 +8,111 @@
 #include "gb.h"
 #include "instructions.h"
 
+#include <algorithm>
+#include <array>
+#include <utility>
+
+struct gb::SM83CPU::OpcodeHandlers
+{
+    using Handler = void (*)(SM83CPU* cpu);
+
+    // Register operand encoded in 3 opcode bits: B, C, D, E, H, L, (HL), A
+    template <u8 Index>
+    static ALWAYS_INLINE auto reg8(SM83CPU* cpu) -> u8&
+    {
+        static_assert(Index != 6, "(HL) isn't a register operand");
+
+        if constexpr (Index == 0) return cpu->regs.B;
+        else if constexpr (Index == 1) return cpu->regs.C;
+        else if constexpr (Index == 2) return cpu->regs.D;
+        else if constexpr (Index == 3) return cpu->regs.E;
+        else if constexpr (Index == 4) return cpu->regs.H;
+        else if constexpr (Index == 5) return cpu->regs.L;
+        else return cpu->regs.A;
+    }
+
+    // CB page: operation in bits 6-7 (rotate/shift group, BIT, RES, SET), bit number or rotate/shift kind
+    // in bits 3-5 and operand in bits 0-2, so every handler is derived from its opcode bits
+    template <u8 CBOpcode, typename Operand>
+    static ALWAYS_INLINE auto executeCBOperation(SM83CPU* cpu, Operand& operand) -> void
+    {
+        constexpr u8 operation = CBOpcode >> 6;
+        constexpr u8 selector = (CBOpcode >> 3) & 0x07;
+
+        if constexpr (operation == 0)
+        {
+            if constexpr (selector == 0) RLC<Operand>(cpu, operand);
+            else if constexpr (selector == 1) RRC<Operand>(cpu, operand);
+            else if constexpr (selector == 2) RL<Operand>(cpu, operand);
+            else if constexpr (selector == 3) RR<Operand>(cpu, operand);
+            else if constexpr (selector == 4) SLA<Operand>(cpu, operand);
+            else if constexpr (selector == 5) SRA<Operand>(cpu, operand);
+            else if constexpr (selector == 6) SWAP<Operand>(cpu, operand);
+            else SRL<Operand>(cpu, operand);
+        }
+        else if constexpr (operation == 1)
+            BIT_<selector, Operand>(cpu, operand);
+        else if constexpr (operation == 2)
+            RES<selector, Operand>(cpu, operand);
+        else
+            SET<selector, Operand>(cpu, operand);
+    }
+
+    template <u8 CBOpcode>
+    static auto executeCB(SM83CPU* cpu) -> void
+    {
+        // 0xCB itself has no base cycles, the whole count comes from the extended table
+        cpu->instructionCycles = extendedInstructionsCyclesTable[CBOpcode];
+
+        if constexpr ((CBOpcode & 0x07) == 6)
+            executeCBOperation<CBOpcode, u16>(cpu, cpu->regs.HL);
+        else
+            executeCBOperation<CBOpcode, u8>(cpu, reg8<CBOpcode & 0x07>(cpu));
+    }
+
+    template <u8 Opcode>
+    static auto execute(SM83CPU* cpu) -> void;
+
+    template <std::size_t... Opcodes>
+    static constexpr auto makeMainTable(std::index_sequence<Opcodes...>) -> std::array<Handler, 256>
+    {
+        return { &execute<static_cast<u8>(Opcodes)>... };
+    }
+
+    template <std::size_t... Opcodes>
+    static constexpr auto makeCBTable(std::index_sequence<Opcodes...>) -> std::array<Handler, 256>
+    {
+        return { &executeCB<static_cast<u8>(Opcodes)>... };
+    }
+
+    static const std::array<Handler, 256> mainTable;
+    static const std::array<Handler, 256> cbTable;
+};
+
 gb::SM83CPU::SM83CPU(GBConsole* device)
-    : system(device), regs({})
+    : regs({}), system(device)
 {
 }
 
 auto gb::SM83CPU::read8(const u16& address) -> u8
 {
+    tickBusAccess();
     return system->read8(address);
 }
 
 auto gb::SM83CPU::read16(const u16& address) -> u16
 {
+#ifdef GB_CPU_M_CYCLE_ACCURATE
+    // Two accesses, each on its own M-cycle
+    return read8(address) | (read8(address + 1) << 8);
+#else
     return system->read16(address);
+#endif
 }
 
 auto gb::SM83CPU::write8(const u16& address, const u8& data) -> void
 {
+    tickBusAccess();
     system->write8(address, data);
 }
 
@@ -37,7 +125,18 @@ auto gb::SM83CPU::write16(const u16& address, const u16& data) -> void
     return;
 #endif 
 
+#ifdef GB_CPU_M_CYCLE_ACCURATE
+    write8(address, static_cast<u8>(data & 0x00FF));
+    write8(address + 1, static_cast<u8>((data >> 8) & 0x00FF));
+#else
     system->write16(address, data);
+#endif
+}
+
+auto gb::SM83CPU::tickMCycle() -> void
+{
+    busCycles += 4;
+    system->tickMCycle();
 }
 
 auto gb::SM83CPU::reset() -> void
@@ -50,30 +149,304 @@ auto gb::SM83CPU::reset() -> void
 auto gb::SM83CPU::clock() -> void
 {
     if (instructionCycles == 0) // Time to fetch and execute next opcode
+        step();
+
+    if (instructionCycles > 0) 
+        instructionCycles--;
+
+    cpuT_CyclesElapsed++;
+    cpuM_CyclesElapsed = cpuT_CyclesElapsed / 4;
+}
+
+auto gb::SM83CPU::step() -> u8
+{
+    if (IME && (system->IF.reg & system->IE.reg & 0x1F))
+    {
+        instructionCycles = interruptServiceRoutine();
+    }
+    else
     {
-        if (system->IME && (system->IF.reg & system->IE.reg & 0x1F))
+        if (interruptEnablePending)
         {
-            instructionCycles = interruptServiceRoutine();
+            interruptEnablePending = false;
+            IME = true;
         }
-        else
+
+        u8 opcode = fetchOpcode();
+
+#ifdef GB_CPU_SWITCH_DISPATCH
+        instructionCycles = instructionsCyclesTable[opcode];
+        decodeAndExecuteInstruction(opcode);
+#else
+        OpcodeHandlers::mainTable[opcode](this);
+#endif
+    }
+
+    return instructionCycles;
+}
+
+auto gb::SM83CPU::fetchOpcode() -> u8
+{
+    const DecodedInstruction* decodedInstruction = (regs.PC <= 0x7FFF) ? nextDecodedInstruction() : nullptr;
+
+    if (decodedInstruction)
+    {
+        tickBusAccess();
+        operandBytes = decodedInstruction->operand;
+        regs.PC++;
+        return decodedInstruction->opcode;
+    }
+
+    // Opcode and operands (3 bytes at most) are read straight from the page when none of them crosses
+    // its end, instructions near the edge or in IO/HRAM take the byte by byte path
+    const u8* page = system->getReadPage(regs.PC);
+
+    if (page && (regs.PC & 0xFF) <= 0xFD)
+    {
+        const u8* instructionBytes = page + (regs.PC & 0xFF);
+        tickBusAccess();
+        operandBytes = instructionBytes + 1;
+        regs.PC++;
+        return instructionBytes[0];
+    }
+
+    operandBytes = nullptr;
+    return read8(regs.PC++);
+}
+
+auto gb::SM83CPU::nextDecodedInstruction() -> const DecodedInstruction*
+{
+    u32 mappingGeneration = system->getROMMappingGeneration();
+
+    // Straight-line execution carries on through the current block as long as no bank got switched
+    if (currentBlock && regs.PC == blockNextAddress && blockPosition < currentBlock->count
+        && mappingGeneration == blockMappingGeneration)
+    {
+        const DecodedInstruction* instruction = &currentBlock->instructions[blockPosition++];
+        blockNextAddress += instruction->length;
+        return instruction;
+    }
+
+    u16 bank = system->getROMBankKey(regs.PC);
+    currentBlock = (bank != BlockCache::NO_BANK) ? blockCache.getBlock(*system, bank, regs.PC) : nullptr;
+
+    if (!currentBlock)
+        return nullptr;
+
+    blockMappingGeneration = mappingGeneration;
+    blockPosition = 1;
+    blockNextAddress = regs.PC + currentBlock->instructions[0].length;
+
+    return &currentBlock->instructions[0];
+}
+
+#ifdef GB_CPU_THREADED_DISPATCH
+// Expands M once per opcode, 00 to FF, so the labels and the label table of the threaded loop are generated
+#define GB_OPCODE_ROW(M, high) M(high##0) M(high##1) M(high##2) M(high##3) M(high##4) M(high##5) M(high##6) M(high##7) \
+    M(high##8) M(high##9) M(high##A) M(high##B) M(high##C) M(high##D) M(high##E) M(high##F)
+#define GB_FOR_EACH_OPCODE(M) GB_OPCODE_ROW(M, 0) GB_OPCODE_ROW(M, 1) GB_OPCODE_ROW(M, 2) GB_OPCODE_ROW(M, 3) \
+    GB_OPCODE_ROW(M, 4) GB_OPCODE_ROW(M, 5) GB_OPCODE_ROW(M, 6) GB_OPCODE_ROW(M, 7) GB_OPCODE_ROW(M, 8) GB_OPCODE_ROW(M, 9) \
+    GB_OPCODE_ROW(M, A) GB_OPCODE_ROW(M, B) GB_OPCODE_ROW(M, C) GB_OPCODE_ROW(M, D) GB_OPCODE_ROW(M, E) GB_OPCODE_ROW(M, F)
+
+#define GB_OPCODE_LABEL_ADDRESS(op) &&opcode_##op,
+
+// HALT and STOP leave the loop so the console takes over the sleeping CPU
+#define GB_OPCODE_LABEL(op) \
+    opcode_##op: \
+        OpcodeHandlers::execute<0x##op>(this); \
+        if (0x##op == 0x76 || 0x##op == 0x10) \
+            goto halted; \
+        goto next;
+
+auto gb::SM83CPU::run(u64 cycleLimit) -> void
+{
+    static void* const opcodeLabels[256] = { GB_FOR_EACH_OPCODE(GB_OPCODE_LABEL_ADDRESS) };
+    const Scheduler& scheduler = system->getScheduler();
+
+dispatch:
+    if (IME && (system->IF.reg & system->IE.reg & 0x1F))
+    {
+        instructionCycles = interruptServiceRoutine();
+        goto next;
+    }
+
+    if (interruptEnablePending)
+    {
+        interruptEnablePending = false;
+        IME = true;
+    }
+
+    goto *opcodeLabels[fetchOpcode()];
+
+    GB_FOR_EACH_OPCODE(GB_OPCODE_LABEL)
+
+next:
+    // The unused opcodes report 0 cycles, but they still take their fetch M-cycle
+    systemCycles += instructionCycles ? instructionCycles : 4;
+    instructionCycles = 0;
+
+    // Re-read every time: register writes of the instruction may have (re)scheduled an event
+    if (systemCycles < std::min(cycleLimit, scheduler.getNextDeadline()))
+        goto dispatch;
+
+    return;
+
+halted:
+    // HALT reports 0 cycles, unless the HALT bug already ran the next instruction
+    systemCycles += instructionCycles ? instructionCycles : 4;
+    instructionCycles = 0;
+}
+
+#undef GB_OPCODE_LABEL
+#undef GB_OPCODE_LABEL_ADDRESS
+#undef GB_FOR_EACH_OPCODE
+#undef GB_OPCODE_ROW
+#endif
+
+auto gb::SM83CPU::executeHaltBug() -> void
+{
+    // The byte after HALT is read as the next opcode without PC moving past it, so it's read again right after
+    // (as the first operand, or as the next opcode). Decoded blocks and page pointers assume PC moves on, the bus doesn't
+    currentBlock = nullptr;
+    operandBytes = nullptr;
+
+    u8 opcode = read8(regs.PC);
+
+    // Another HALT: PC can never get past it, the CPU keeps going through both of them
+    if (opcode == 0x76)
+    {
+        regs.PC--;
+        instructionCycles = 4;
+        return;
+    }
+
+#ifdef GB_CPU_SWITCH_DISPATCH
+    instructionCycles = instructionsCyclesTable[opcode];
+    decodeAndExecuteInstruction(opcode);
+#else
+    OpcodeHandlers::mainTable[opcode](this);
+#endif
+
+    instructionCycles += 4; // The HALT itself
+}
+
+auto gb::SM83CPU::skipIdleLoop(u16 loopStart, u16 branchAddress) -> void
+{
+    // A pending interrupt would be serviced at the next instruction boundary
+    if ((IME && system->checkPendingInterrupts()) || interruptEnablePending)
+        return;
+
+    bool inROM = branchAddress <= 0x7FFF;
+    u32 mappingGeneration = system->getROMMappingGeneration();
+
+    if (inROM && branchAddress == rejectedLoopAddress && mappingGeneration == rejectedLoopGeneration)
+        return;
+
+    u32 iterationCycles = matchIdleLoop(loopStart, branchAddress);
+
+    if (iterationCycles == 0)
+    {
+        if (inROM)
         {
-            if (interruptEnablePending)
-            {
-                interruptEnablePending = false;
-                system->IME = true;
-            }
-
-            u8 opcode = read8(regs.PC++);
-            instructionCycles = instructionsCyclesTable[opcode];
-            decodeAndExecuteInstruction(opcode);
+            rejectedLoopAddress = branchAddress;
+            rejectedLoopGeneration = mappingGeneration;
         }
+
+        return;
     }
 
-    if (instructionCycles > 0) 
-        instructionCycles--;
+    // The branch being executed (base cycles plus 4 for being taken) completes the current iteration, the next
+    // one starts at loopTimestamp
+    u64 loopTimestamp = system->getCyclesElapsed() + instructionCycles + 4;
+    u16 previousAddress = idleLoopAddress;
+    u64 iterationTimestamp = idleLoopTimestamp;
 
-    cpuT_CyclesElapsed++;
-    cpuM_CyclesElapsed = cpuT_CyclesElapsed / 4;
+    idleLoopAddress = branchAddress;
+    idleLoopTimestamp = loopTimestamp;
+
+    // The iteration ending here has to have run whole right after the previous one (no interrupt handler in
+    // between) with no event dispatched since its read, so the value it saw is still the current one
+    if (branchAddress != previousAddress || loopTimestamp - iterationTimestamp != iterationCycles
+        || system->getLastEventCycles() > iterationTimestamp)
+        return;
+
+    // Every iteration starting before the deadline reads that same value. The last of them runs normally
+    // so the event and any interrupt it raises land exactly where they would have
+    u64 deadline = system->getScheduler().getNextDeadline();
+
+    if (deadline == Scheduler::NO_EVENT) // LCD off, LY and STAT won't change at all
+        deadline = loopTimestamp + GBConsole::MAX_HALT_SKIP_CYCLES;
+
+    if (deadline <= loopTimestamp)
+        return;
+
+    u32 iterations = static_cast<u32>((deadline - loopTimestamp - 1) / iterationCycles);
+
+    if (iterations == 0)
+        return;
+
+    system->skipCycles(iterations * iterationCycles);
+    idleLoopTimestamp += iterations * iterationCycles;
+    idleLoopStats.hits++;
+    idleLoopStats.cyclesSkipped += iterations * iterationCycles;
+}
+
+auto gb::SM83CPU::matchIdleLoop(u16 loopStart, u16 branchAddress) -> u32
+{
+    // IO registers could have side effects on read
+    if (loopStart >= 0xFE00 && loopStart <= 0xFF7F)
+        return 0;
+
+    u16 address = loopStart;
+    u8 load = read8(address);
+    u16 ioAddress = 0;
+
+    if (load == 0xF0) // LDH A,(n)
+    {
+        ioAddress = 0xFF00 | read8(address + 1);
+        address += 2;
+    }
+    else if (load == 0xFA) // LD A,(nn)
+    {
+        ioAddress = read16(address + 1);
+        address += 3;
+    }
+    else
+    {
+        return 0;
+    }
+
+    if (ioAddress != 0xFF41 && ioAddress != 0xFF44)
+        return 0;
+
+    u32 cycles = instructionsCyclesTable[load];
+    u8 test = read8(address);
+
+    if (test == 0xFE || test == 0xE6) // CP n, AND n
+    {
+        cycles += instructionsCyclesTable[test];
+        address += 2;
+    }
+    else if (test == 0xA7 || test == 0xB7) // AND A, OR A
+    {
+        cycles += instructionsCyclesTable[test];
+        address += 1;
+    }
+    else if (test == 0xCB && (read8(address + 1) & 0xC7) == 0x47) // BIT b,A
+    {
+        cycles += extendedInstructionsCyclesTable[read8(address + 1)];
+        address += 2;
+    }
+    else
+    {
+        return 0;
+    }
+
+    // Only the taken branch itself may follow
+    if (address != branchAddress)
+        return 0;
+
+    return cycles + instructionsCyclesTable[0x20] + 4;
 }
 
 auto gb::SM83CPU::checkPendingInterrupts() -> bool
@@ -123,12 +496,13 @@ auto gb::SM83CPU::interruptServiceRoutine() -> u8
         regs.PC = 0x0060;
     }
 
-    system->IME = false;
+    IME = false;
 
     return 20; //ISP takes 5 m-cycles (20 t-cycles)
 }
 
-auto gb::SM83CPU::decodeAndExecuteInstruction(u8 opcode) -> void
+// Always inlined: each table handler calls it with a constant opcode, so the switch folds down to that single case
+ALWAYS_INLINE auto gb::SM83CPU::decodeAndExecuteInstruction(u8 opcode) -> void
 {
     switch (opcode)
     {
@@ -136,8 +510,7 @@ auto gb::SM83CPU::decodeAndExecuteInstruction(u8 opcode) -> void
         NOP();
         break;
     case 0x01:
-        LD<REGISTER, IMMEDIATE, u16>(this, regs.BC, read16(regs.PC));
-        regs.PC += 2;
+        LD<REGISTER, IMMEDIATE, u16>(this, regs.BC, fetch16());
         break;
     case 0x02:
         LD<ADDRESS_PTR, REGISTER, u16>(this, regs.BC, regs.A);
@@ -152,16 +525,15 @@ auto gb::SM83CPU::decodeAndExecuteInstruction(u8 opcode) -> void
         DEC_<REGISTER, u8>(this, regs.B);
         break;
     case 0x06:
-        LD<REGISTER, IMMEDIATE, u8>(this, regs.B, read8(regs.PC++));
+        LD<REGISTER, IMMEDIATE, u8>(this, regs.B, fetch8());
         break;
     case 0x07:
         RLCA(this);
         break;
     case 0x08:
         {
-            u16 address = read16(regs.PC);
+            u16 address = fetch16();
             LD_u16SP(this, address);
-            regs.PC += 2;
         }
         break;
     case 0x09:
@@ -180,17 +552,16 @@ auto gb::SM83CPU::decodeAndExecuteInstruction(u8 opcode) -> void
         DEC_<REGISTER, u8>(this, regs.C);
         break;
     case 0x0E:
-        LD<REGISTER, IMMEDIATE, u8>(this, regs.C, read8(regs.PC++));
+        LD<REGISTER, IMMEDIATE, u8>(this, regs.C, fetch8());
         break;
     case 0x0F:
         RRCA(this);
         break;
     case 0x10:
-        // TODO: STOP instruction
+        STOP(this);
         break;
     case 0x11:
-        LD<REGISTER, IMMEDIATE, u16>(this, regs.DE, read16(regs.PC));
-        regs.PC += 2;
+        LD<REGISTER, IMMEDIATE, u16>(this, regs.DE, fetch16());
         break;
     case 0x12:
         LD<ADDRESS_PTR, REGISTER, u16>(this, regs.DE, regs.A);
@@ -205,7 +576,7 @@ auto gb::SM83CPU::decodeAndExecuteInstruction(u8 opcode) -> void
         DEC_<REGISTER, u8>(this, regs.D);
         break;
     case 0x16:
-        LD<REGISTER, IMMEDIATE, u8>(this, regs.D, read8(regs.PC++));
+        LD<REGISTER, IMMEDIATE, u8>(this, regs.D, fetch8());
         break;
     case 0x17:
         RLA(this);
@@ -229,7 +600,7 @@ auto gb::SM83CPU::decodeAndExecuteInstruction(u8 opcode) -> void
         DEC_<REGISTER, u8>(this, regs.E);
         break;
     case 0x1E:
-        LD<REGISTER, IMMEDIATE, u8>(this, regs.E, read8(regs.PC++));
+        LD<REGISTER, IMMEDIATE, u8>(this, regs.E, fetch8());
         break;
     case 0x1F:
         RRA(this);
@@ -238,8 +609,7 @@ auto gb::SM83CPU::decodeAndExecuteInstruction(u8 opcode) -> void
         instructionCycles += JR<JP_NZ>(this);
         break;
     case 0x21:
-        LD<REGISTER, IMMEDIATE, u16>(this, regs.HL, read16(regs.PC));
-        regs.PC += 2;
+        LD<REGISTER, IMMEDIATE, u16>(this, regs.HL, fetch16());
         break;
     case 0x22:
         LD<ADDRESS_PTR, REGISTER, u16>(this, regs.HL, regs.A);
@@ -255,7 +625,7 @@ auto gb::SM83CPU::decodeAndExecuteInstruction(u8 opcode) -> void
         DEC_<REGISTER, u8>(this, regs.H);
         break;
     case 0x26:
-        LD<REGISTER, IMMEDIATE, u8>(this, regs.H, read8(regs.PC++));
+        LD<REGISTER, IMMEDIATE, u8>(this, regs.H, fetch8());
         break;
     case 0x27:
         DAA(this);
@@ -279,7 +649,7 @@ auto gb::SM83CPU::decodeAndExecuteInstruction(u8 opcode) -> void
         DEC_<REGISTER, u8>(this, regs.L);
         break;
     case 0x2E:
-        LD<REGISTER, IMMEDIATE, u8>(this, regs.L, read8(regs.PC++));
+        LD<REGISTER, IMMEDIATE, u8>(this, regs.L, fetch8());
         break;
     case 0x2F:
         CPL(this);
@@ -288,8 +658,7 @@ auto gb::SM83CPU::decodeAndExecuteInstruction(u8 opcode) -> void
         instructionCycles += JR<JP_NC>(this);
         break;
     case 0x31:
-        LD<REGISTER, IMMEDIATE, u16>(this, regs.SP, read16(regs.PC));
-        regs.PC += 2;
+        LD<REGISTER, IMMEDIATE, u16>(this, regs.SP, fetch16());
         break;
     case 0x32:
         LD<ADDRESS_PTR, REGISTER, u16>(this, regs.HL, regs.A);
@@ -305,7 +674,7 @@ auto gb::SM83CPU::decodeAndExecuteInstruction(u8 opcode) -> void
         DEC_<ADDRESS_PTR, u16>(this, regs.HL);
         break;
     case 0x36:
-        LD<ADDRESS_PTR, IMMEDIATE, u16>(this, regs.HL, read8(regs.PC++));
+        LD<ADDRESS_PTR, IMMEDIATE, u16>(this, regs.HL, fetch8());
         break;
     case 0x37:
         SCF(this);
@@ -329,7 +698,7 @@ auto gb::SM83CPU::decodeAndExecuteInstruction(u8 opcode) -> void
         DEC_<REGISTER, u8>(this, regs.A);
         break;
     case 0x3E:
-        LD<REGISTER, IMMEDIATE, u8>(this, regs.A, read8(regs.PC++));
+        LD<REGISTER, IMMEDIATE, u8>(this, regs.A, fetch8());
         break;
     case 0x3F:
         CCF(this);
@@ -737,7 +1106,7 @@ auto gb::SM83CPU::decodeAndExecuteInstruction(u8 opcode) -> void
         PUSH(this, regs.BC);
         break;
     case 0xC6:
-        ADDC<IMMEDIATE, u8>(this, read8(regs.PC++), false);
+        ADDC<IMMEDIATE, u8>(this, fetch8(), false);
         break;
     case 0xC7:
         RST(this, 0x00);
@@ -753,7 +1122,7 @@ auto gb::SM83CPU::decodeAndExecuteInstruction(u8 opcode) -> void
         break;
     case 0xCB:
         {
-            u8 cbOpcode = read8(regs.PC++);
+            u8 cbOpcode = fetch8();
             instructionCycles += extendedInstructionsCyclesTable[cbOpcode];
             decodeAndExecuteCBInstruction(cbOpcode);
         }
@@ -765,7 +1134,7 @@ auto gb::SM83CPU::decodeAndExecuteInstruction(u8 opcode) -> void
         CALL(this);
         break;
     case 0xCE:
-        ADDC<IMMEDIATE, u8>(this, read8(regs.PC++), true);
+        ADDC<IMMEDIATE, u8>(this, fetch8(), true);
         break;
     case 0xCF:
         RST(this, 0x08);
@@ -786,7 +1155,7 @@ auto gb::SM83CPU::decodeAndExecuteInstruction(u8 opcode) -> void
         PUSH(this, regs.DE);
         break;
     case 0xD6:
-        SUBC<IMMEDIATE, u8>(this, read8(regs.PC++), false);
+        SUBC<IMMEDIATE, u8>(this, fetch8(), false);
         break;
     case 0xD7:
         RST(this, 0x10);
@@ -804,14 +1173,14 @@ auto gb::SM83CPU::decodeAndExecuteInstruction(u8 opcode) -> void
         instructionCycles += CALL<JP_C>(this);
         break;
     case 0xDE:
-        SUBC<IMMEDIATE, u8>(this, read8(regs.PC++), true);
+        SUBC<IMMEDIATE, u8>(this, fetch8(), true);
         break;
     case 0xDF:
         RST(this, 0x18);
         break;
     case 0xE0:
         {
-            u16 address = 0xFF00 | read8(regs.PC++);
+            u16 address = 0xFF00 | fetch8();
             LD<ADDRESS_PTR, REGISTER, u16>(this, address, regs.A);
         }
         break;
@@ -828,36 +1197,36 @@ auto gb::SM83CPU::decodeAndExecuteInstruction(u8 opcode) -> void
         PUSH(this, regs.HL);
         break;
     case 0xE6:
-        BITWISE_OP<AND, IMMEDIATE, u8>(this, read8(regs.PC++));
+        BITWISE_OP<AND, IMMEDIATE, u8>(this, fetch8());
         break;
     case 0xE7:
         RST(this, 0x20);
         break;
     case 0xE8:
-        ADD_SPi8(this, static_cast<s8>(read8(regs.PC++)));
+        ADD_SPi8(this, static_cast<s8>(fetch8()));
         break;
     case 0xE9:
         JP(this, true); // regs.HL
         break;
     case 0xEA:
         {
-            u16 address = read16(regs.PC);
+            u16 address = fetch16();
             LD<ADDRESS_PTR, REGISTER, u16>(this, address, regs.A);
-            regs.PC += 2;
         }
         break;
     case 0xEE:
-        BITWISE_OP<XOR, IMMEDIATE, u8>(this, read8(regs.PC++));
+        BITWISE_OP<XOR, IMMEDIATE, u8>(this, fetch8());
         break;
     case 0xEF:
         RST(this, 0x28);
         break;
     case 0xF0:
-        LD<REGISTER, IMMEDIATE, u8>(this, regs.A, read8(0xFF00 | read8(regs.PC++)));
+        LD<REGISTER, IMMEDIATE, u8>(this, regs.A, read8(0xFF00 | fetch8()));
         break;
     case 0xF1:
         POP(this, regs.AF);
         regs.AF &= 0xFFF0;
+        discardPendingFlags();
         break;
     case 0xF2:
         LD<REGISTER, IMMEDIATE, u8>(this, regs.A, read8(0xFF00 | regs.C));
@@ -866,30 +1235,30 @@ auto gb::SM83CPU::decodeAndExecuteInstruction(u8 opcode) -> void
         DI(system);
         break;
     case 0xF5:
+        materializeFlags();
         regs.AF &= 0xFFF0;
         PUSH(this, regs.AF);
         break;
     case 0xF6:
-        BITWISE_OP<OR, IMMEDIATE, u8>(this, read8(regs.PC++));
+        BITWISE_OP<OR, IMMEDIATE, u8>(this, fetch8());
         break;
     case 0xF7:
         RST(this, 0x30);
         break;
     case 0xF8:
-        LD_HLSPi8(this, static_cast<s8>(read8(regs.PC++)));
+        LD_HLSPi8(this, static_cast<s8>(fetch8()));
         break;
     case 0xF9:
         LD<REGISTER, REGISTER, u16>(this, regs.SP, regs.HL);
         break;
     case 0xFA:
-        LD<REGISTER, IMMEDIATE, u8>(this, regs.A, read8(read16(regs.PC)));
-        regs.PC += 2;
+        LD<REGISTER, IMMEDIATE, u8>(this, regs.A, read8(fetch16()));
         break;
     case 0xFB:
         EI(system);
         break;
     case 0xFE:
-        CP<IMMEDIATE, u8>(this, read8(regs.PC++));
+        CP<IMMEDIATE, u8>(this, fetch8());
         break;
     case 0xFF:
         RST(this, 0x38);
@@ -1681,6 +2050,7 @@ auto gb::SM83CPU::decodeAndExecuteCBInstruction(u8 cbOpcode) -> void
 auto gb::SM83CPU::setRegisterValuesPostBootROM() -> void
 {
     regs.AF = (read8(0x014D) == 0x00) ? 0x0100 : 0x01B0;
+    discardPendingFlags();
     regs.BC = 0x0013;
     regs.DE = 0x00D8;
     regs.HL = 0x014D;
@@ -1722,7 +2092,7 @@ auto gb::SM83CPU::setRegisterValuesPostBootROM() -> void
     write8(0xFF43, 0x00);
     write8(0xFF44, 0x00);
     write8(0xFF45, 0x00);
-    write8(0xFF46, 0xFF);
+    //write8(0xFF46, 0xFF); // Set by GBConsole::skipBootROM, writing it would start a transfer
     write8(0xFF47, 0xFC);
     /*write8(0xFF48, 0x85);
     write8(0xFF49, 0x85);*/
@@ -1744,3 +2114,42 @@ auto gb::SM83CPU::setRegisterValuesPostBootROM() -> void
     write8(0xFF70, 0xFF);
     write8(0xFFFF, 0x00);
 }
+
+template <u8 Opcode>
+auto gb::SM83CPU::OpcodeHandlers::execute(SM83CPU* cpu) -> void
+{
+    constexpr u8 dst = (Opcode >> 3) & 0x07;
+    constexpr u8 src = Opcode & 0x07;
+
+    cpu->instructionCycles = instructionsCyclesTable[Opcode];
+
+    if constexpr (Opcode == 0xCB)
+    {
+        cbTable[cpu->fetch8()](cpu);
+    }
+    else if constexpr (Opcode >= 0x40 && Opcode <= 0x7F && dst != 6 && src != 6) // LD r, r'
+    {
+        LD<REGISTER, REGISTER, u8>(cpu, reg8<dst>(cpu), reg8<src>(cpu));
+    }
+    else if constexpr (Opcode >= 0x80 && Opcode <= 0xBF && src != 6) // ALU A, r
+    {
+        if constexpr (dst == 0) ADDC<REGISTER, u8>(cpu, reg8<src>(cpu), false);
+        else if constexpr (dst == 1) ADDC<REGISTER, u8>(cpu, reg8<src>(cpu), true);
+        else if constexpr (dst == 2) SUBC<REGISTER, u8>(cpu, reg8<src>(cpu), false);
+        else if constexpr (dst == 3) SUBC<REGISTER, u8>(cpu, reg8<src>(cpu), true);
+        else if constexpr (dst == 4) BITWISE_OP<AND, REGISTER, u8>(cpu, reg8<src>(cpu));
+        else if constexpr (dst == 5) BITWISE_OP<XOR, REGISTER, u8>(cpu, reg8<src>(cpu));
+        else if constexpr (dst == 6) BITWISE_OP<OR, REGISTER, u8>(cpu, reg8<src>(cpu));
+        else CP<REGISTER, u8>(cpu, reg8<src>(cpu));
+    }
+    else // Irregular encodings keep their single definition in the switch, folded to this opcode's case
+    {
+        cpu->decodeAndExecuteInstruction(Opcode);
+    }
+}
+
+const std::array<gb::SM83CPU::OpcodeHandlers::Handler, 256> gb::SM83CPU::OpcodeHandlers::mainTable =
+    gb::SM83CPU::OpcodeHandlers::makeMainTable(std::make_index_sequence<256>());
+
+const std::array<gb::SM83CPU::OpcodeHandlers::Handler, 256> gb::SM83CPU::OpcodeHandlers::cbTable =
+    gb::SM83CPU::OpcodeHandlers::makeCBTable(std::make_index_sequence<256>());
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2023 pabletefest
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#include "file_rom_bank_provider.h"
+
+#include <algorithm>
+
+gb::FileROMBankProvider::FileROMBankProvider(const std::string& path, u32 romSize, u16 cacheCapacity)
+    : romFile(path, std::ifstream::binary), romSize(romSize)
+{
+    u16 nBanks = static_cast<u16>(std::max<u32>(romSize / GB_ROM_BANK_SIZE, 1));
+    cacheCapacity = std::min<u16>(std::max<u16>(cacheCapacity, 3), nBanks);
+
+    cacheData.resize(cacheCapacity * GB_ROM_BANK_SIZE);
+    entryBanks.assign(cacheCapacity, NO_BANK);
+    entryLastUse.assign(cacheCapacity, 0);
+    bankEntries.assign(nBanks, NO_ENTRY);
+
+    // Bank 0 is always mapped somewhere (the fixed slot on every mapper), it's pinned to entry 0
+    readBank(0, 0);
+}
+
+auto gb::FileROMBankProvider::loadBank(u8 slot, u16 bank) -> const u8*
+{
+    bank %= bankEntries.size();
+
+    if (slotBanks[slot] == bank) // Slot refresh without a bank switch
+        return cacheData.data() + bankEntries[bank] * GB_ROM_BANK_SIZE;
+
+    u16 entry = bankEntries[bank];
+
+    if (entry != NO_ENTRY)
+    {
+        stats.hits++;
+    }
+    else
+    {
+        stats.misses++;
+        entry = findVictimEntry(slot);
+
+        if (entryBanks[entry] != NO_BANK)
+        {
+            stats.evictions++;
+            bankEntries[entryBanks[entry]] = NO_ENTRY;
+        }
+
+        readBank(bank, entry);
+    }
+
+    entryLastUse[entry] = ++useCounter;
+    slotBanks[slot] = bank;
+
+    return cacheData.data() + entry * GB_ROM_BANK_SIZE;
+}
+
+auto gb::FileROMBankProvider::findVictimEntry(u8 slot) const -> u16
+{
+    u16 victim = NO_ENTRY;
+
+    for (u16 entry = 1; entry < entryBanks.size(); entry++) // Entry 0 holds the pinned bank 0
+    {
+        if (entryBanks[entry] == NO_BANK)
+            return entry;
+
+        // The bank mapped in the other slot is referenced by the bus page table, it can't go away
+        if (entryBanks[entry] == slotBanks[slot ^ 1])
+            continue;
+
+        if (victim == NO_ENTRY || entryLastUse[entry] < entryLastUse[victim])
+            victim = entry;
+    }
+
+    return victim;
+}
+
+auto gb::FileROMBankProvider::readBank(u16 bank, u16 entry) -> void
+{
+    u8* data = cacheData.data() + entry * GB_ROM_BANK_SIZE;
+
+    // Files shorter than the header size read as open bus past the end
+    std::fill(data, data + GB_ROM_BANK_SIZE, 0xFF);
+    romFile.clear();
+    romFile.seekg(static_cast<std::streamoff>(bank) * GB_ROM_BANK_SIZE);
+    romFile.read(reinterpret_cast<char*>(data), GB_ROM_BANK_SIZE);
+
+    entryBanks[entry] = bank;
+    bankEntries[bank] = entry;
+}
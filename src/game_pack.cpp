@@ -6,66 +6,358 @@
  */
 
 #include "game_pack.h"
-#include "no_mbc.h"
+#include "memory_rom_bank_provider.h"
+#include "file_rom_bank_provider.h"
+#include "mapped_file_rom_bank_provider.h"
+#include "partition_rom_bank_provider.h"
 #include "util_funcs.h"
 
+#include <algorithm>
 #include <fstream>
 #include <cstring>
 
+#ifndef GB_ROMS_DIRECTORY
+    #ifdef ESP32
+        #define GB_ROMS_DIRECTORY "/spiffs/"
+    #else
+        #define GB_ROMS_DIRECTORY ""
+    #endif
+#endif
+
+// ROMs up to this size are loaded whole, bigger ones are streamed bank by bank from the file
+#ifndef GB_MAX_RESIDENT_ROM_SIZE
+    #ifdef ESP32
+        #define GB_MAX_RESIDENT_ROM_SIZE (128 * 1024)
+    #else
+        #define GB_MAX_RESIDENT_ROM_SIZE (512 * 1024)
+    #endif
+#endif
+
+// Number of 16KB banks kept in memory for streamed ROMs
+#ifndef GB_ROM_BANK_CACHE_SIZE
+    #ifdef ESP32
+        #define GB_ROM_BANK_CACHE_SIZE 8
+    #else
+        #define GB_ROM_BANK_CACHE_SIZE 16
+    #endif
+#endif
+
+// Minimum emulated time between two writes of the battery save (one second)
+#ifndef GB_SAVE_FLUSH_INTERVAL
+    #define GB_SAVE_FLUSH_INTERVAL 4194304
+#endif
+
 gb::GamePak::GamePak(const std::string& filename)
 {
     std::memset(&header, 0x00, sizeof(CartridgeHeader));
 
-    std::ifstream ifs;
+    bool romLoaded = false;
 
-    ifs.open("/spiffs/" + filename, std::ifstream::binary);
+#if defined(ESP32) && defined(GB_ROM_PARTITION_LABEL)
+    // A ROM flashed into the data partition takes precedence over the SPIFFS file
+    romLoaded = openROMPartition(GB_ROM_PARTITION_LABEL);
+#endif
 
-    if (ifs.is_open())
-    {
-        printf("\nROM file '%s' opened\n", filename.c_str());
-
-        // TEMP: skipping bootrom
-        ifs.seekg(256, std::ios_base::cur);
-
-        // Read file header
-        ifs.read((char*)&header, sizeof(CartridgeHeader));
+    if (!romLoaded)
+        romLoaded = openROMFile(filename);
 
+    if (romLoaded)
+    {
         gameName = std::string((const char*)header.title);
 
-        u32 romSize = romSizesTable[header.romSize];
-        nROMBanks = static_cast<u8>(romSize / convertKBToBytes(16));
+        if (header.ramSize < ramSizesTable.size())
+            vRAMMemory.resize(ramSizesTable[header.ramSize], 0x00);
 
-        ifs.seekg(0);
-        vROMMemory.resize(nROMBanks * convertKBToBytes(16)); // We could use romSize
-        ifs.read((char*)vROMMemory.data(), romSize);
+        u8 nRAMBanks = static_cast<u8>(vRAMMemory.size() / convertKBToBytes(8));
 
+        // The mapper type is resolved here once, accesses then dispatch through the variant without virtual calls
         switch (header.cartridgeType)
         {
         case 0x00:
-            mapper = std::make_unique<NoMBCMapper>(nROMBanks);
+        case 0x08:
+        case 0x09:
+            mapper.emplace<NoMBCMapper>(nROMBanks, nRAMBanks);
             break;
         case 0x01:
-            //mapper = std::make_unique<NoMBCMapper>(nROMBanks);
+        case 0x02:
+        case 0x03:
+            mapper.emplace<MBC1Mapper>(nROMBanks, nRAMBanks);
+            break;
+        case 0x0F:
+        case 0x10:
+            mapper.emplace<MBC3Mapper>(nROMBanks, nRAMBanks, true);
+            break;
+        case 0x11:
+        case 0x12:
+        case 0x13:
+            mapper.emplace<MBC3Mapper>(nROMBanks, nRAMBanks, false);
+            break;
+        case 0x19:
+        case 0x1A:
+        case 0x1B:
+        case 0x1C:
+        case 0x1D:
+        case 0x1E:
+            mapper.emplace<MBC5Mapper>(nROMBanks, nRAMBanks);
+            break;
+        default:
+            printf("Cartridge type %02X not supported, falling back to no MBC\n", header.cartridgeType);
+            mapper.emplace<NoMBCMapper>(nROMBanks, nRAMBanks);
+            break;
+        }
+
+        // Cartridge types with a battery keeping the RAM (and RTC) contents
+        switch (header.cartridgeType)
+        {
+        case 0x03:
+        case 0x09:
+        case 0x0F:
+        case 0x10:
+        case 0x13:
+        case 0x1B:
+        case 0x1E:
+            hasBattery = true;
+            savePath = GB_ROMS_DIRECTORY + filename.substr(0, filename.find_last_of('.')) + ".sav";
             break;
         default:
             break;
         }
+
+        updateROMSlots();
+        loadSave();
     }
-    else
+
+    printf("ROM buffer size is %d bytes\n", getRomBufferSize());
+}
+
+gb::GamePak::~GamePak()
+{
+    flushSave();
+}
+
+auto gb::GamePak::openROMFile(const std::string& filename) -> bool
+{
+    std::ifstream ifs;
+
+    ifs.open(GB_ROMS_DIRECTORY + filename, std::ifstream::binary);
+
+    if (!ifs.is_open())
     {
         printf("\nROM file '%s' could not be opened\n", filename.c_str());
+        return false;
     }
 
-    printf("ROM buffer size is %d bytes\n", getRomBufferSize());
+    printf("\nROM file '%s' opened\n", filename.c_str());
+
+    // TEMP: skipping bootrom
+    ifs.seekg(256, std::ios_base::cur);
+
+    // Read file header
+    ifs.read((char*)&header, sizeof(CartridgeHeader));
+
+    u32 romSize = getROMSizeFromHeader();
+    nROMBanks = static_cast<u16>(romSize / GB_ROM_BANK_SIZE);
+
+#ifdef GB_HAS_MAPPED_FILE_ROM
+    // Mapping the file avoids copying the image regardless of its size
+    auto mappedROM = std::make_unique<MappedFileROMBankProvider>(GB_ROMS_DIRECTORY + filename, romSize);
+
+    if (mappedROM->isMapped())
+    {
+        printf("ROM file mapped into memory\n");
+        romBanks = std::move(mappedROM);
+        return true;
+    }
+#endif
+
+    if (romSize <= GB_MAX_RESIDENT_ROM_SIZE)
+    {
+        std::vector<u8> romData(nROMBanks * GB_ROM_BANK_SIZE); // We could use romSize
+        ifs.seekg(0);
+        ifs.read((char*)romData.data(), romSize);
+        romBanks = std::make_unique<MemoryROMBankProvider>(std::move(romData));
+    }
+    else
+    {
+        printf("ROM banks will be streamed from the file (%d banks cached)\n", GB_ROM_BANK_CACHE_SIZE);
+        romBanks = std::make_unique<FileROMBankProvider>(GB_ROMS_DIRECTORY + filename, romSize, GB_ROM_BANK_CACHE_SIZE);
+    }
+
+    return true;
 }
 
-auto gb::GamePak::read(u16 addr, u8& data) -> bool
+#ifdef ESP32
+auto gb::GamePak::openROMPartition(const char* label) -> bool
+{
+    auto partitionROM = std::make_unique<PartitionROMBankProvider>(label);
+
+    if (!partitionROM->isMapped())
+    {
+        printf("\nROM partition '%s' not found, loading from SPIFFS\n", label);
+        return false;
+    }
+
+    std::memcpy(&header, partitionROM->loadBank(0, 0) + 0x100, sizeof(CartridgeHeader));
+
+    u32 romSize = getROMSizeFromHeader();
+
+    if (romSize > partitionROM->getSize())
+    {
+        printf("\nROM partition '%s' is too small (%u bytes) for the ROM it holds (%u bytes)\n", label, partitionROM->getSize(), romSize);
+        std::memset(&header, 0x00, sizeof(CartridgeHeader));
+        return false;
+    }
+
+    printf("\nROM mapped from flash partition '%s'\n", label);
+
+    nROMBanks = static_cast<u16>(romSize / GB_ROM_BANK_SIZE);
+    romBanks = std::move(partitionROM);
+
+    return true;
+}
+#endif
+
+auto gb::GamePak::loadSave() -> void
 {
-    u16 mappedAddress = 0x0000;
+    if (!hasBattery)
+        return;
+
+    dirtyRAMPages.assign((vRAMMemory.size() + 0xFF) >> 8, false);
+
+    std::ifstream ifs(savePath, std::ifstream::binary);
+
+    if (!ifs.is_open())
+    {
+        fullSaveNeeded = true;
+        return;
+    }
+
+    ifs.read((char*)vRAMMemory.data(), vRAMMemory.size());
 
-    if (mapper->mapRead(addr, mappedAddress))
+    if (static_cast<u32>(ifs.gcount()) < vRAMMemory.size())
+        fullSaveNeeded = true;
+
+    // The RTC state is stored right after the RAM contents
+    if (auto* mbc3 = std::get_if<MBC3Mapper>(&mapper); mbc3 && mbc3->hasClock())
     {
-        data = vROMMemory[mappedAddress];
+        MBC3Mapper::RTCState rtcState;
+
+        if (ifs.read((char*)&rtcState, sizeof(rtcState)))
+        {
+            mbc3->loadRTCState(rtcState);
+            savedRTCState = rtcState;
+        }
+        else
+            fullSaveNeeded = true;
+    }
+
+    printf("Save file '%s' loaded\n", savePath.c_str());
+}
+
+auto gb::GamePak::flushSave() -> void
+{
+    if (!hasBattery)
+        return;
+
+    auto* mbc3 = std::get_if<MBC3Mapper>(&mapper);
+    bool hasClock = mbc3 && mbc3->hasClock();
+
+    // The stored host timestamp lets a reload catch up a running clock, so the RTC tail only needs rewriting once
+    // the registers read differently (a second went by, the game set or halted the clock)
+    MBC3Mapper::RTCState rtcState = { };
+    bool rtcChanged = false;
+
+    if (hasClock)
+    {
+        rtcState = mbc3->saveRTCState();
+        rtcChanged = std::memcmp(rtcState.registers, savedRTCState.registers, sizeof(rtcState.registers)) != 0 ||
+                     std::memcmp(rtcState.latchedRegisters, savedRTCState.latchedRegisters, sizeof(rtcState.latchedRegisters)) != 0;
+    }
+
+    if (!saveDirty && !fullSaveNeeded && !rtcChanged)
+        return;
+
+    std::fstream fs;
+
+    if (!fullSaveNeeded)
+        fs.open(savePath, std::fstream::in | std::fstream::out | std::fstream::binary);
+
+    if (!fs.is_open())
+    {
+        fs.open(savePath, std::fstream::out | std::fstream::binary | std::fstream::trunc);
+        fullSaveNeeded = true;
+    }
+
+    if (!fs.is_open())
+    {
+        printf("Save file '%s' could not be written\n", savePath.c_str());
+        return;
+    }
+
+    if (fullSaveNeeded)
+    {
+        fs.write((const char*)vRAMMemory.data(), vRAMMemory.size());
+    }
+    else
+    {
+        for (u32 page = 0; page < dirtyRAMPages.size(); page++)
+        {
+            if (!dirtyRAMPages[page])
+                continue;
+
+            fs.seekp(page << 8);
+            fs.write((const char*)vRAMMemory.data() + (page << 8), std::min<u32>(0x100, vRAMMemory.size() - (page << 8)));
+        }
+    }
+
+    if (hasClock && (rtcChanged || fullSaveNeeded))
+    {
+        fs.seekp(vRAMMemory.size());
+        fs.write((const char*)&rtcState, sizeof(rtcState));
+        savedRTCState = rtcState;
+    }
+
+    std::fill(dirtyRAMPages.begin(), dirtyRAMPages.end(), false);
+    saveDirty = false;
+    fullSaveNeeded = false;
+    lastFlushTimestamp = cycleCounter ? *cycleCounter : 0;
+}
+
+auto gb::GamePak::flushSaveIfDue() -> void
+{
+    if (!saveDirty)
+        return;
+
+    u64 now = cycleCounter ? *cycleCounter : 0;
+
+    if (now >= lastFlushTimestamp && now - lastFlushTimestamp < GB_SAVE_FLUSH_INTERVAL)
+        return;
+
+    flushSave();
+}
+
+auto gb::GamePak::getROMSizeFromHeader() const -> u32
+{
+    return header.romSize < romSizesTable.size() ? romSizesTable[header.romSize] : romSizesTable[0];
+}
+
+auto gb::GamePak::read(u16 addr, u8& data) -> bool
+{
+    if (addr <= 0x7FFF)
+    {
+        const u8* bankData = romSlotData[addr >> 14];
+        data = bankData ? bankData[addr & 0x3FFF] : 0xFF;
+        return true;
+    }
+    else if (addr >= 0xA000 && addr <= 0xBFFF)
+    {
+        if (std::visit([addr, &data](auto& m) { return m.readRAMRegister(addr, data); }, mapper))
+            return true;
+
+        const Mapper& state = getMapperState();
+
+        // Disabled or missing RAM reads as open bus. RAM smaller than 8KB makes no full bank, so it never gets enabled
+        data = state.isRAMEnabled() ? vRAMMemory[(state.getRAMBankOffset() + (addr & 0x1FFF)) % vRAMMemory.size()] : 0xFF;
         return true;
     }
 
@@ -74,12 +366,34 @@ auto gb::GamePak::read(u16 addr, u8& data) -> bool
 
 auto gb::GamePak::write(u16 addr, u8 data) -> bool
 {
-    u16 mappedAddress = 0x0000;
-
-    if (mapper->mapWrite(addr, mappedAddress, data))
+    if (addr <= 0x7FFF)
     {
-        // No need to modify ROM memory
-        vROMMemory[mappedAddress] = data;
+        // No need to modify ROM memory, writes only reach the mapper registers
+        std::visit([addr, data](auto& m) { m.writeRegister(addr, data); }, mapper);
+        updateROMSlots();
+        return true;
+    }
+    else if (addr >= 0xA000 && addr <= 0xBFFF)
+    {
+        if (std::visit([addr, data](auto& m) { return m.writeRAMRegister(addr, data); }, mapper))
+            return true;
+
+        const Mapper& state = getMapperState();
+
+        if (state.isRAMEnabled())
+        {
+            u32 offset = (state.getRAMBankOffset() + (addr & 0x1FFF)) % vRAMMemory.size();
+
+            // Stores of the value already there don't need to reach the save file
+            if (hasBattery && vRAMMemory[offset] != data)
+            {
+                dirtyRAMPages[offset >> 8] = true;
+                saveDirty = true;
+            }
+
+            vRAMMemory[offset] = data;
+        }
+
         return true;
     }
 
@@ -91,12 +405,58 @@ auto gb::GamePak::getHeaderInfo() const -> const CartridgeHeader&
     return header;
 }
 
-auto gb::GamePak::getROMBuffer() const -> const u8*
+auto gb::GamePak::getRomBufferSize() const -> const u32
 {
-    return vROMMemory.data();
+    return romBanks ? nROMBanks * GB_ROM_BANK_SIZE : 0;
 }
 
-auto gb::GamePak::getRomBufferSize() const -> const u32
+auto gb::GamePak::getMappedROMData(u8 slot) const -> const u8*
+{
+    return romSlotData[slot];
+}
+
+auto gb::GamePak::getMappedROMBank(u8 slot) const -> u16
+{
+    return getMapperState().getROMBank(slot);
+}
+
+auto gb::GamePak::getMappedRAMData() -> u8*
+{
+    const Mapper& state = getMapperState();
+
+    // Only full 8KB banks go in the page table
+    if (!state.isRAMEnabled() || vRAMMemory.size() < convertKBToBytes(8))
+        return nullptr;
+
+    return vRAMMemory.data() + state.getRAMBankOffset();
+}
+
+auto gb::GamePak::connectCycleCounter(const u64* cycleCounter) -> void
+{
+    this->cycleCounter = cycleCounter;
+    lastFlushTimestamp = cycleCounter ? *cycleCounter : 0;
+
+    if (auto* mbc3 = std::get_if<MBC3Mapper>(&mapper))
+        mbc3->setCycleCounter(cycleCounter);
+}
+
+auto gb::GamePak::getROMBankStats() const -> ROMBankProvider::Stats
+{
+    return romBanks ? romBanks->getStats() : ROMBankProvider::Stats();
+}
+
+auto gb::GamePak::updateROMSlots() -> void
+{
+    if (!romBanks)
+        return;
+
+    // Providers return right away when the slot already holds the bank
+    const Mapper& state = getMapperState();
+    romSlotData[0] = romBanks->loadBank(0, state.getROMBank(0));
+    romSlotData[1] = romBanks->loadBank(1, state.getROMBank(1));
+}
+
+auto gb::GamePak::getMapperState() const -> const Mapper&
 {
-    return vROMMemory.size() * sizeof(decltype(vROMMemory)::value_type);
+    return std::visit([](const auto& m) -> const Mapper& { return m; }, mapper);
 }
@@ -12,6 +12,8 @@
 
 #include <iostream>
 #include <cstring>
+#include <cassert>
+#include <algorithm>
 
 gb::GBConsole::GBConsole()
     : cpu(this), IE({}), IF({}), timer(this), ppu(this)
@@ -19,42 +21,68 @@ gb::GBConsole::GBConsole()
     std::memset(wram.data(), 0x00, wram.size());
     std::memset(hram.data(), 0x00, hram.size());
 
+    mapMemoryPages();
+
     cpu.reset();
     ppu.reset();
 }
 
+gb::GBConsole::~GBConsole()
+{
+    ejectCartridge();
+}
+
 auto gb::GBConsole::insertCartridge(const Ref<GamePak>& cartridge) -> void
 {
+    ejectCartridge();
+
     this->gamePak = cartridge;
+    gamePak->connectCycleCounter(&cpu.systemCycles);
+    cpu.clearBlockCache();
+    cpu.resetIdleLoopStats();
+    mapCartridgePages();
+}
+
+// The cartridge is shared and can outlive the console: its save is written while the clock still reads our cycle
+// counter, then it stops pointing at it
+auto gb::GBConsole::ejectCartridge() -> void
+{
+    if (!gamePak)
+        return;
+
+    gamePak->flushSave();
+    gamePak->connectCycleCounter(nullptr);
 }
 
-auto gb::GBConsole::read8(const u16& address) -> u8
+auto gb::GBConsole::readSlowPath(u16 address) -> u8
 {
     u8 dataRead = 0x00;
 
+    // The CPU sees the byte in transfer on the bus an OAM DMA occupies, and 0xFF in OAM
+    if (UNLIKELY(dmaActive) && isOAMDMAConflict(address))
+        return (address >= 0xFE00) ? 0xFF : readOAMDMASource(getOAMDMAIndex());
+
     if (address < 0x0100 && ((bootROMMappedRegister & 0x01) == 0))
     {
         // BootROM is mapped in the first 256 bytes of address space so PC points to this code
         dataRead = boot_rom[address & 0xFF];
     }
-    else if (gamePak->read(address, dataRead))
+    else if (address <= 0x7FFF || (address >= 0xA000 && address <= 0xBFFF))
     {
         // Let the Cartridge handle the read
+        gamePak->read(address, dataRead);
     }
     else if (address >= 0x8000 && address <= 0x9FFF) // VRAM
     {
         dataRead = ppu.read(address);
     }
-    else if (address >= 0xA000 && address <= 0xBFFF)
-    {
-    }
     else if (address >= 0xC000 && address <= 0xDFFF) // WRAM
     {
         dataRead = wram[address & 0x1FFF];
     }
     else if (address >= 0xE000 && address <= 0xFDFF) // (ECHO RAM)
     {
-        dataRead = wram[address & 0x1DFF];
+        dataRead = wram[address & 0x1FFF];
     }
     else if (address >= 0xFE00 && address <= 0xFE9F) // OAM
     {
@@ -164,30 +192,35 @@ auto gb::GBConsole::read16(const u16& address) -> u16
     return (read8(address + 1) << 8) | read8(address);
 }
 
-auto gb::GBConsole::write8(const u16& address, const u8& data) -> void
+auto gb::GBConsole::writeSlowPath(u16 address, u8 data) -> void
 {
-    if (address < 0x100 && ((bootROMMappedRegister & 0x01) == 0))
+    if (UNLIKELY(dmaActive) && isOAMDMAConflict(address))
+    {
+        // Lost to the OAM DMA holding that bus
+    }
+    else if (address < 0x100 && ((bootROMMappedRegister & 0x01) == 0))
     {
         // BootROM is mapped in the first 256 bytes of address space so no writes allowed
     }
-    else if (gamePak->write(address, data))
+    else if (address <= 0x7FFF || (address >= 0xA000 && address <= 0xBFFF))
     {
-        // Let the cartridge handle the write
+        // Let the cartridge handle the write, mapper register writes may switch banks so the page table is refreshed
+        gamePak->write(address, data);
+
+        if (address <= 0x7FFF)
+            mapCartridgePages();
     }
     else if (address >= 0x8000 && address <= 0x9FFF) // VRAM
     {
         ppu.write(address, data);
     }
-    else if (address >= 0xA000 && address <= 0xBFFF)
-    {
-    }
     else if (address >= 0xC000 && address <= 0xDFFF) // WRAM
     {
         wram[address & 0x1FFF] = data;
     }
     else if (address >= 0xE000 && address <= 0xFDFF) // (ECHO RAM)
     {
-        wram[address & 0x1DFF] = data;
+        wram[address & 0x1FFF] = data;
     }
     else if (address >= 0xFE00 && address <= 0xFE9F) // OAM
     {
@@ -243,20 +276,7 @@ auto gb::GBConsole::write8(const u16& address, const u8& data) -> void
             ppu.write(address, data);
             break;
         case 0xFF46:
-            {
-                dmaSourceAddress = data;
-                u16 sourceAddress = (dmaSourceAddress << 8) & 0xFF00;
-                const void* srcPtr = nullptr;
-
-                if (sourceAddress < 0x8000)
-                    srcPtr = gamePak->getROMBuffer();
-                else if (sourceAddress >= 0xC000 && sourceAddress <= 0xFDFF)
-                    srcPtr = wram.data();
-                else
-                    assert(false);
-
-                std::memcpy(ppu.OAM.data(), srcPtr, ppu.OAM.size() * sizeof(PPU::SpriteInfoOAM));
-            }
+            startOAMDMA(data);
             break;
         case 0xFF47:
             ppu.write(address, data);
@@ -269,6 +289,7 @@ auto gb::GBConsole::write8(const u16& address, const u8& data) -> void
             break;
         case 0xFF50:
             bootROMMappedRegister = data;
+            mapCartridgePages();
             break;
         default:
             break;
@@ -290,16 +311,188 @@ auto gb::GBConsole::write16(const u16& address, const u16& data) -> void
     write8(address + 1, static_cast<u8>((data >> 8) & 0x00FF));
 }
 
+auto gb::GBConsole::mapMemoryPages() -> void
+{
+    readPages.fill(nullptr);
+    writePages.fill(nullptr);
+
+    for (u16 page = 0x80; page <= 0x9F; page++) // VRAM
+    {
+        readPages[page] = ppu.VRAM.data() + ((page - 0x80) << 8);
+        writePages[page] = ppu.VRAM.data() + ((page - 0x80) << 8);
+    }
+
+    for (u16 page = 0xC0; page <= 0xFD; page++) // WRAM and ECHO RAM
+    {
+        readPages[page] = wram.data() + ((page & 0x1F) << 8);
+        writePages[page] = wram.data() + ((page & 0x1F) << 8);
+    }
+
+    // OAM, IO registers, HRAM and IE (pages 0xFE and 0xFF) always go through the handlers
+    mapCartridgePages();
+}
+
+auto gb::GBConsole::mapCartridgePages() -> void
+{
+    romMappingGeneration++;
+
+    for (u8 slot = 0; slot < romSlotBanks.size(); slot++)
+        romSlotBanks[slot] = gamePak ? gamePak->getMappedROMBank(slot) : 0;
+
+    for (u16 page = 0x00; page <= 0x7F; page++) // ROM, writes are mapper registers
+    {
+        const u8* bankData = gamePak ? gamePak->getMappedROMData(page >> 6) : nullptr;
+        readPages[page] = bankData ? bankData + ((page & 0x3F) << 8) : nullptr;
+        writePages[page] = nullptr;
+    }
+
+    if ((bootROMMappedRegister & 0x01) == 0)
+        readPages[0x00] = boot_rom;
+
+    u8* ramData = gamePak ? gamePak->getMappedRAMData() : nullptr;
+
+    for (u16 page = 0xA0; page <= 0xBF; page++) // External RAM, battery backed writes take the slow path to be tracked
+    {
+        readPages[page] = ramData ? ramData + ((page - 0xA0) << 8) : nullptr;
+        writePages[page] = ramData && !gamePak->tracksRAMWrites() ? ramData + ((page - 0xA0) << 8) : nullptr;
+    }
+
+    if (dmaActive) // Last, the external RAM pages are on the DMA's bus too
+        unmapOAMDMABus();
+}
+
+auto gb::GBConsole::startOAMDMA(u8 sourcePage) -> void
+{
+    static constexpr u32 TRANSFER_CYCLES = 160 * 4;
+
+    // Writing the register during a transfer restarts it from the new source, after the bytes already due
+    if (dmaActive)
+        syncOAMDMA(cpu.systemCycles);
+
+    dmaSourceAddress = sourcePage;
+    dmaStartCycles = cpu.systemCycles + 4; // The first byte moves one M-cycle after the write
+    dmaBytesCopied = 0;
+    mapOAMDMAPages();
+
+    u64 endTimestamp = dmaStartCycles + TRANSFER_CYCLES;
+    scheduler.schedule(EventType::OAMDMAEnd, endTimestamp);
+
+    // The CPU can't see OAM before the end either way, so when the PPU doesn't scan it meanwhile (VBlank, where
+    // games run their HRAM routine, or LCD off) copying it all at once is indistinguishable from byte by byte
+    if (ppu.getNextOAMScanTimestamp() >= endTimestamp)
+        syncOAMDMA(endTimestamp);
+}
+
+auto gb::GBConsole::syncOAMDMA(u64 timestamp) -> void
+{
+    u8* oam = reinterpret_cast<u8*>(ppu.OAM.data());
+    u8 bytesDue = (timestamp <= dmaStartCycles) ? 0 : static_cast<u8>(std::min<u64>((timestamp - dmaStartCycles) / 4, 160));
+
+    if (bytesDue <= dmaBytesCopied)
+        return;
+
+    if (dmaSourceData)
+        std::memcpy(oam + dmaBytesCopied, dmaSourceData + dmaBytesCopied, bytesDue - dmaBytesCopied);
+    else
+        for (u8 i = dmaBytesCopied; i < bytesDue; i++)
+            oam[i] = readOAMDMASource(i);
+
+    dmaBytesCopied = bytesDue;
+}
+
+auto gb::GBConsole::onOAMDMAEndEvent(u64 timestamp) -> void
+{
+    syncOAMDMA(timestamp);
+    dmaActive = false;
+    mapMemoryPages();
+}
+
+auto gb::GBConsole::mapOAMDMAPages() -> void
+{
+    // Source resolved through the current mapping (switched banks included). The other bus masters are kept off
+    // the bus it's on for the whole transfer, so the mapping can't change under it until the end
+    dmaActive = false;
+    mapMemoryPages();
+
+    dmaSourceData = readPages[(dmaSourceAddress >= 0xE0) ? dmaSourceAddress - 0x20 : dmaSourceAddress];
+    dmaActive = true;
+    unmapOAMDMABus();
+}
+
+auto gb::GBConsole::unmapOAMDMABus() -> void
+{
+    // Accesses to the pages of the occupied bus go through the slow path, where they hit the conflict
+    if (dmaSourceAddress >= 0x80 && dmaSourceAddress <= 0x9F)
+    {
+        std::fill(readPages.begin() + 0x80, readPages.begin() + 0xA0, nullptr);
+        std::fill(writePages.begin() + 0x80, writePages.begin() + 0xA0, nullptr);
+    }
+    else
+    {
+        std::fill(readPages.begin(), readPages.begin() + 0x80, nullptr);
+        std::fill(writePages.begin(), writePages.begin() + 0x80, nullptr);
+        std::fill(readPages.begin() + 0xA0, readPages.begin() + 0xFE, nullptr);
+        std::fill(writePages.begin() + 0xA0, writePages.begin() + 0xFE, nullptr);
+    }
+
+    romMappingGeneration++; // Decoded blocks must not carry on past the start of the transfer
+}
+
+auto gb::GBConsole::isOAMDMAConflict(u16 address) const -> bool
+{
+    if (address >= 0xFE00)
+        return address <= 0xFEFF;
+
+    bool sourceOnVRAMBus = dmaSourceAddress >= 0x80 && dmaSourceAddress <= 0x9F;
+    bool addressOnVRAMBus = address >= 0x8000 && address <= 0x9FFF;
+
+    return sourceOnVRAMBus == addressOnVRAMBus;
+}
+
+auto gb::GBConsole::readOAMDMASource(u8 index) -> u8
+{
+    if (dmaSourceData)
+        return dmaSourceData[index];
+
+    // Cartridge RAM handled by the mapper (disabled, RTC registers)
+    u8 data = 0xFF;
+
+    if (gamePak)
+        gamePak->read(static_cast<u16>((dmaSourceAddress << 8) | index), data);
+
+    return data;
+}
+
+auto gb::GBConsole::getOAMDMAIndex() const -> u8
+{
+    u64 now = cpu.systemCycles;
+    return (now <= dmaStartCycles) ? 0 : static_cast<u8>(std::min<u64>((now - dmaStartCycles) / 4, 159));
+}
+
 auto gb::GBConsole::reset() -> void
 {
     cpu.reset();
     ppu.reset();
+    pendingClockCycles = 0;
 }
 
 auto gb::GBConsole::clock() -> void
 {
-    ppu.clock();
-    timer.clock();
+    if (isStopMode && !wakeFromStopMode())
+        return;
+
+#ifdef GB_CPU_M_CYCLE_ACCURATE
+    // Time already moves with the CPU bus accesses, so instructions run whole and the next calls wait them out
+    if (pendingClockCycles == 0)
+        pendingClockCycles = stepInstruction();
+
+    if (pendingClockCycles > 0)
+        pendingClockCycles--;
+#else
+    cpu.systemCycles++;
+
+    if (cpu.systemCycles >= scheduler.getNextDeadline())
+        dispatchEvents();
 
     if (isHaltMode)
     {
@@ -312,8 +505,7 @@ auto gb::GBConsole::clock() -> void
     {
         cpu.clock();
     }
-
-    systemCyclesElapsed++;
+#endif
 }
 
 auto gb::GBConsole::step(u32 numberCycles) -> void
@@ -322,6 +514,176 @@ auto gb::GBConsole::step(u32 numberCycles) -> void
         clock();
 }
 
+// Alternative to clock(): the CPU runs a whole instruction and time jumps by its cost, PPU and
+// timer only do work when one of their scheduled events falls inside that window
+auto gb::GBConsole::stepInstruction() -> u32
+{
+    u32 cycles = 4;
+
+    if (isHaltMode)
+    {
+        cycles = stepHalted(Scheduler::NO_EVENT);
+    }
+    else
+    {
+        cycles = cpu.step();
+        cpu.instructionCycles = 0;
+
+        // HALT and the unused opcodes report 0 cycles, but they still take their fetch M-cycle
+        if (cycles == 0)
+            cycles = 4;
+
+#ifdef GB_CPU_M_CYCLE_ACCURATE
+        // The bus accesses already moved time forward, only the internal M-cycles are left
+        u32 busCycles = cpu.takeBusCycles();
+        cpu.systemCycles += (cycles > busCycles) ? cycles - busCycles : 0;
+#else
+        cpu.systemCycles += cycles;
+#endif
+
+        if (cpu.systemCycles >= scheduler.getNextDeadline())
+            dispatchEvents();
+    }
+
+    return cycles;
+}
+
+auto gb::GBConsole::enterStopMode() -> void
+{
+    isStopMode = true;
+    isHaltMode = true;
+    timer.write(0xFF04, 0x00); // DIV is reset on STOP
+}
+
+auto gb::GBConsole::wakeFromStopMode() -> bool
+{
+    // Any pressed button on a selected line (P14 d-pad, P15 buttons) restarts the clock
+    u8 lines = 0x0F;
+
+    if (!(joypadRegister & 0x10))
+        lines &= controllerState.dpad;
+
+    if (!(joypadRegister & 0x20))
+        lines &= controllerState.buttons;
+
+    if (lines == 0x0F)
+        return false;
+
+    isStopMode = false;
+    isHaltMode = false;
+    requestInterrupt(InterruptType::Joypad);
+
+    return true;
+}
+
+auto gb::GBConsole::stepHalted(u64 cycleLimit) -> u32
+{
+    u32 cycles = 4;
+
+    // No time passes in STOP, the instruction after it runs on the next call once a button wakes the CPU up
+    if (isStopMode)
+    {
+        wakeFromStopMode();
+        return 0;
+    }
+
+    if (!checkPendingInterrupts())
+    {
+        // Emulated interrupts are only raised by scheduled events (VBlank, STAT, TIMA overflow), so nothing
+        // can wake the CPU up before the next deadline: sleep straight there (M-cycle aligned). The host can
+        // only raise one between calls, cycleLimit keeps the sleep within the caller's budget for that
+        u64 deadline = std::min(scheduler.getNextDeadline(), cycleLimit);
+        u64 cyclesToDeadline = (deadline == Scheduler::NO_EVENT) ? MAX_HALT_SKIP_CYCLES : deadline - cpu.systemCycles;
+
+        cycles = static_cast<u32>(std::min<u64>(cyclesToDeadline, MAX_HALT_SKIP_CYCLES));
+        cycles = std::max<u32>((cycles + 3) & ~3u, 4);
+    }
+
+    cpu.systemCycles += cycles;
+
+    if (cpu.systemCycles >= scheduler.getNextDeadline())
+        dispatchEvents();
+
+    if (checkPendingInterrupts())
+    {
+        isHaltMode = false;
+    }
+
+    return cycles;
+}
+
+auto gb::GBConsole::tickMCycle() -> void
+{
+    cpu.systemCycles += 4;
+
+    if (cpu.systemCycles >= scheduler.getNextDeadline())
+        dispatchEvents();
+}
+
+auto gb::GBConsole::run(u32 cycleBudget) -> u32
+{
+    u64 startCycles = cpu.systemCycles;
+
+    if (isHaltMode)
+    {
+        stepHalted(startCycles + cycleBudget);
+    }
+    else
+    {
+#ifdef GB_CPU_THREADED_DISPATCH
+        cpu.run(cpu.systemCycles + cycleBudget);
+
+        if (cpu.systemCycles >= scheduler.getNextDeadline())
+            dispatchEvents();
+#else
+        u64 cycleLimit = std::min(cpu.systemCycles + cycleBudget, scheduler.getNextDeadline());
+
+        do
+        {
+            stepInstruction();
+        } while (cpu.systemCycles < cycleLimit && !isHaltMode);
+#endif
+    }
+
+    return static_cast<u32>(cpu.systemCycles - startCycles);
+}
+
+auto gb::GBConsole::dispatchEvents() -> void
+{
+    EventType type;
+    u64 timestamp = 0;
+
+    while (scheduler.popDueEvent(cpu.systemCycles, type, timestamp))
+    {
+        lastEventCycles = cpu.systemCycles;
+
+        switch (type)
+        {
+        case EventType::PPUMode3:
+            // The OAM scan sees what a running transfer has copied so far
+            if (dmaActive)
+                syncOAMDMA(timestamp);
+
+            ppu.onMode3Event(timestamp);
+            break;
+        case EventType::PPUHBlank:
+            ppu.onHBlankEvent();
+            break;
+        case EventType::PPUNewLine:
+            ppu.onNewLineEvent(timestamp);
+            break;
+        case EventType::TimerOverflow:
+            timer.onOverflowEvent(timestamp);
+            break;
+        case EventType::OAMDMAEnd:
+            onOAMDMAEndEvent(timestamp);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
 auto gb::GBConsole::requestInterrupt(InterruptType type) -> void
 {
     switch (type)
@@ -379,9 +741,71 @@ auto gb::GBConsole::getGameTitleFromHeader() -> std::string
     return std::string(reinterpret_cast<const char*>(gamePak->getHeaderInfo().title));
 }
 
+auto gb::GBConsole::saveState(std::vector<u8>& buffer) -> void
+{
+    StateSizeCounter counter;
+    serialize(counter);
+
+    SaveStateHeader header;
+    std::memcpy(header.magic, SAVE_STATE_MAGIC, sizeof(header.magic));
+    header.version = SAVE_STATE_VERSION;
+    header.romGlobalChecksum = getROMGlobalChecksum();
+
+    buffer.clear();
+    buffer.reserve(sizeof(SaveStateHeader) + counter.getSize());
+
+    StateWriter writer(buffer);
+    writer.value(header);
+    serialize(writer);
+}
+
+auto gb::GBConsole::loadState(const u8* data, u32 size) -> bool
+{
+    if (size < sizeof(SaveStateHeader))
+        return false;
+
+    SaveStateHeader header;
+    std::memcpy(&header, data, sizeof(SaveStateHeader));
+
+    if (std::memcmp(header.magic, SAVE_STATE_MAGIC, sizeof(header.magic)) != 0 || header.version != SAVE_STATE_VERSION ||
+        header.romGlobalChecksum != getROMGlobalChecksum())
+        return false;
+
+    // The layout is fixed for a given version and cartridge, so a size check up front guarantees the read can't stop halfway
+    StateSizeCounter counter;
+    serialize(counter);
+
+    if (size - sizeof(SaveStateHeader) != counter.getSize())
+        return false;
+
+    StateReader reader(data + sizeof(SaveStateHeader), size - sizeof(SaveStateHeader));
+    serialize(reader);
+
+    // Host pointers aren't part of the state, the page table is rebuilt from the restored mapping registers
+    if (dmaActive)
+        mapOAMDMAPages();
+    else
+        mapMemoryPages();
+
+    lastEventCycles = cpu.systemCycles;
+    pendingClockCycles = 0;
+
+    return reader.isValid();
+}
+
+auto gb::GBConsole::getROMGlobalChecksum() const -> u16
+{
+    if (!gamePak)
+        return 0;
+
+    const u8* checksum = gamePak->getHeaderInfo().globalChecksum;
+    return (checksum[0] << 8) | checksum[1];
+}
+
 auto gb::GBConsole::skipBootROM() -> void
 {
     //cpu.regs.PC = 0x0100;
     cpu.setRegisterValuesPostBootROM();
     timer.setDIVtoSkippedBootromValue();
+    dmaSourceAddress = 0xFF; // Register value only, writing it would start a transfer
 }
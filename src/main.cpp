@@ -10,6 +10,9 @@
 #include "gb.h"
 #include "game_pack.h"
 #include "ppu.h"
+#ifdef GB_ENABLE_REWIND
+#include "rewind.h"
+#endif
 
 #include <iomanip>
 
@@ -19,6 +22,10 @@
 gb::GBConsole* emulator = nullptr;
 static std::string gameName = "Tetris V1.1.gb";
 static constexpr u8 textFont = 2;
+static constexpr u32 STOP_POLL_INTERVAL_MS = 16; // Input polling period while the console is in STOP, about a frame
+#ifdef GB_ENABLE_REWIND
+static gb::RewindBuffer* rewind = nullptr;
+#endif
 
 void setup()
 {
@@ -39,6 +46,10 @@ void setup()
 
   emulator->insertCartridge(cartridge);
   emulator->reset();
+
+#ifdef GB_ENABLE_REWIND
+  rewind = new gb::RewindBuffer();
+#endif
   
   emulator->getPPU().printTextToDisplay(gameName, 1, 1, textFont);
 }
@@ -101,6 +112,11 @@ void loop()
   //   Serial.println("Triangle");
   // }
 
+#ifdef GB_ENABLE_REWIND
+  // Holding triangle walks back through the rewind history, one snapshot per frame
+  bool rewinding = GamePad.isTrianglePressed() && rewind->stepBack(*emulator);
+#endif
+
   if (GamePad.isStartPressed())
   {
     emulator->controllerState.buttons &= ~0x8;
@@ -113,10 +129,20 @@ void loop()
     // Serial.println("SELECT pressed!");
   }
 
+  // With the LCD off no frame completes, cap the frame so the buttons still get polled
+  u64 frameDeadline = emulator->getCyclesElapsed() + gb::GBConsole::CYCLES_PER_FRAME;
+
   do
   {
-    emulator->clock();
-  } while (!emulator->getPPU().frameCompleted);
+    emulator->run(static_cast<u32>(frameDeadline - emulator->getCyclesElapsed()));
+  } while (!emulator->getPPU().frameCompleted && !emulator->isStopped() && emulator->getCyclesElapsed() < frameDeadline);
+
+  // STOP: the buttons read above are the only way out, sleep until the next poll instead of spinning
+  if (emulator->isStopped())
+  {
+    delay(STOP_POLL_INTERVAL_MS);
+    return;
+  }
 
   // Serial.println("Frame finished");
 
@@ -124,6 +150,13 @@ void loop()
 
   emulator->getPPU().drawFrameToDisplay();
 
+  emulator->getCartridge()->flushSaveIfDue();
+
+#ifdef GB_ENABLE_REWIND
+  if (!rewinding)
+    rewind->onFrameCompleted(*emulator);
+#endif
+
   u32 endTime = millis();
 
   // Serial.printf("Elapsed time %dms\n", endTime - startTime);
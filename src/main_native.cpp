@@ -0,0 +1,228 @@
+/*
+ * Copyright (C) 2023 pabletefest
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+// Headless host entry point (env:native / CMake) used to measure emulation core throughput off-device
+
+#include "gb.h"
+#include "game_pack.h"
+#include "ppu.h"
+#include "rewind.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static constexpr u32 DEFAULT_FRAMES_TO_RUN = 600;
+static constexpr double GB_FRAMES_PER_SECOND = 59.7275;
+
+static auto hashFrameBuffer(gb::PPU& ppu) -> u32
+{
+    // FNV-1a over the sink contents, handy to check that optimizations don't change the output
+    const u8* pixels = ppu.getPixelsBufferData();
+    u32 hash = 2166136261u;
+
+    for (u32 i = 0; i < GB_PIXELS_WIDTH * GB_PIXELS_HEIGHT * sizeof(u16); i++)
+    {
+        hash ^= pixels[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+static auto hashBytes(const std::vector<u8>& data) -> u32
+{
+    u32 hash = 2166136261u;
+
+    for (u8 byte : data)
+    {
+        hash ^= byte;
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+static auto runFrame(gb::GBConsole& emulator, bool cycleStepped) -> void
+{
+    // With the LCD off no frame ever completes, so a frame is also over after a frame's worth of cycles
+    u64 frameDeadline = emulator.getCyclesElapsed() + gb::GBConsole::CYCLES_PER_FRAME;
+
+    if (cycleStepped)
+    {
+        do
+        {
+            emulator.clock();
+        } while (!emulator.getPPU().frameCompleted && !emulator.isStopped() && emulator.getCyclesElapsed() < frameDeadline);
+    }
+    else
+    {
+        do
+        {
+            emulator.run(static_cast<u32>(frameDeadline - emulator.getCyclesElapsed()));
+        } while (!emulator.getPPU().frameCompleted && !emulator.isStopped() && emulator.getCyclesElapsed() < frameDeadline);
+    }
+
+    emulator.getPPU().frameCompleted = false;
+}
+
+static auto benchmarkSaveStates(gb::GBConsole& emulator) -> void
+{
+    static constexpr u32 ITERATIONS = 1000;
+    static constexpr u32 ROUND_TRIP_FRAMES = 60;
+
+    std::vector<u8> state;
+
+    auto saveStartTime = std::chrono::steady_clock::now();
+
+    for (u32 i = 0; i < ITERATIONS; i++)
+        emulator.saveState(state);
+
+    auto loadStartTime = std::chrono::steady_clock::now();
+    bool loaded = true;
+
+    for (u32 i = 0; i < ITERATIONS; i++)
+        loaded &= emulator.loadState(state.data(), static_cast<u32>(state.size()));
+
+    auto endTime = std::chrono::steady_clock::now();
+
+    printf("Save state: %zu bytes - Save: %.2fus - Load: %.2fus\n", state.size(),
+        std::chrono::duration<double, std::micro>(loadStartTime - saveStartTime).count() / ITERATIONS,
+        std::chrono::duration<double, std::micro>(endTime - loadStartTime).count() / ITERATIONS);
+
+    // Running the same frames again from the restored state has to produce the same picture
+    for (u32 frame = 0; frame < ROUND_TRIP_FRAMES; frame++)
+        runFrame(emulator, false);
+
+    u32 expectedHash = hashFrameBuffer(emulator.getPPU());
+    loaded &= emulator.loadState(state.data(), static_cast<u32>(state.size()));
+
+    for (u32 frame = 0; frame < ROUND_TRIP_FRAMES; frame++)
+        runFrame(emulator, false);
+
+    printf("State round trip: %s\n", loaded && hashFrameBuffer(emulator.getPPU()) == expectedHash ? "OK" : "MISMATCH");
+}
+
+static auto reportRewind(gb::GBConsole& emulator, gb::RewindBuffer& rewind, const std::vector<u32>& snapshotHashes) -> void
+{
+    const gb::RewindBuffer::Stats& stats = rewind.getStats();
+
+    printf("Rewind: %llu captures - %u snapshots in %u bytes - %.1f bytes/snapshot - capture %uus (max %uus)\n",
+        static_cast<unsigned long long>(stats.captures), stats.snapshotsStored, stats.bytesUsed,
+        stats.captures > 1 ? static_cast<double>(stats.totalSnapshotBytes) / (stats.captures - 1) : 0.0,
+        stats.lastCaptureMicros, stats.maxCaptureMicros);
+
+    // Walking back has to restore exactly the states that were captured, newest first
+    std::vector<u8> state;
+    u32 verified = 0;
+    bool matches = true;
+
+    for (auto expectedHash = snapshotHashes.rbegin(); expectedHash != snapshotHashes.rend() && rewind.stepBack(emulator); ++expectedHash)
+    {
+        emulator.saveState(state);
+        matches &= hashBytes(state) == *expectedHash;
+        verified++;
+    }
+
+    printf("Rewind check: %u snapshots restored - %s\n", verified, matches ? "OK" : "MISMATCH");
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        printf("Usage: %s <rom file> [frames] [--cycle-stepped] [--state-bench] [--rewind]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    const std::string romPath = argv[1];
+    u32 framesToRun = DEFAULT_FRAMES_TO_RUN;
+    bool cycleStepped = false; // Tick every component per T-cycle (GBConsole::clock) instead of per instruction
+    bool stateBenchmark = false; // Measure save/load state latency once the frames have run
+    bool rewindEnabled = false; // Capture rewind snapshots while running, then report and walk back through them
+
+    for (int i = 2; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--cycle-stepped") == 0)
+            cycleStepped = true;
+        else if (std::strcmp(argv[i], "--state-bench") == 0)
+            stateBenchmark = true;
+        else if (std::strcmp(argv[i], "--rewind") == 0)
+            rewindEnabled = true;
+        else
+            framesToRun = static_cast<u32>(std::strtoul(argv[i], nullptr, 10));
+    }
+
+    Scope<gb::GBConsole> emulator = std::make_unique<gb::GBConsole>();
+    Ref<gb::GamePak> cartridge = std::make_shared<gb::GamePak>(romPath);
+
+    if (cartridge->getRomBufferSize() == 0)
+        return EXIT_FAILURE;
+
+    emulator->insertCartridge(cartridge);
+    emulator->reset();
+
+    printf("Running '%s' for %u frames (%s, %s, %s)\n", emulator->getGameTitleFromHeader().c_str(), framesToRun,
+        cycleStepped ? "cycle stepped" : "instruction stepped", GB_CPU_DISPATCH_NAME, GB_CPU_TIMING_NAME);
+
+    gb::RewindBuffer rewind(rewindEnabled ? GB_REWIND_BUFFER_SIZE : 0);
+    std::vector<u32> snapshotHashes;
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    for (u32 frame = 0; frame < framesToRun; frame++)
+    {
+        runFrame(*emulator, cycleStepped);
+
+        // Nothing presses buttons here, so a STOP would never end
+        if (emulator->isStopped())
+        {
+            printf("CPU stopped (STOP) during frame %u, no input can wake it up\n", frame);
+            framesToRun = frame + 1;
+            break;
+        }
+
+        emulator->getPPU().drawFrameToDisplay();
+
+        emulator->getCartridge()->flushSaveIfDue();
+
+        if (rewindEnabled && rewind.onFrameCompleted(*emulator))
+            snapshotHashes.push_back(hashBytes(rewind.getLatestState()));
+    }
+
+    auto endTime = std::chrono::steady_clock::now();
+    double elapsedMs = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+    double frameTimeMs = elapsedMs / framesToRun;
+
+    printf("Elapsed time: %.2fms - Frame time: %.4fms - FPS: %.2f (%.2fx real time)\n",
+        elapsedMs, frameTimeMs, 1000.0 / frameTimeMs, (1000.0 / frameTimeMs) / GB_FRAMES_PER_SECOND);
+    printf("Emulated cycles: %llu - Frame hash: %08X\n", static_cast<unsigned long long>(emulator->getCyclesElapsed()), hashFrameBuffer(emulator->getPPU()));
+
+    gb::ROMBankProvider::Stats bankStats = cartridge->getROMBankStats();
+
+    if (bankStats.misses > 0)
+        printf("ROM bank cache: %u hits - %u misses - %u evictions\n", bankStats.hits, bankStats.misses, bankStats.evictions);
+
+    const gb::BlockCache::Stats& blockStats = emulator->getCPU().getBlockCacheStats();
+    printf("Decoded block cache: %u hits - %u misses\n", blockStats.hits, blockStats.misses);
+
+    const gb::SM83CPU::IdleLoopStats& idleStats = emulator->getCPU().getIdleLoopStats();
+    printf("Idle loops: %u skips - %llu cycles skipped (%.1f%% of emulated time)\n", idleStats.hits,
+        static_cast<unsigned long long>(idleStats.cyclesSkipped), 100.0 * idleStats.cyclesSkipped / std::max<u64>(emulator->getCyclesElapsed(), 1));
+
+    if (stateBenchmark)
+        benchmarkSaveStates(*emulator);
+
+    if (rewindEnabled)
+        reportRewind(*emulator, rewind, snapshotHashes);
+
+    return EXIT_SUCCESS;
+}
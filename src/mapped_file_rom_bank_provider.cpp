@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2023 pabletefest
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#include "mapped_file_rom_bank_provider.h"
+
+#ifdef GB_HAS_MAPPED_FILE_ROM
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+gb::MappedFileROMBankProvider::MappedFileROMBankProvider(const std::string& path, u32 romSize)
+    : romSize(romSize)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+
+    if (fd < 0)
+        return;
+
+    struct stat fileInfo;
+
+    if (fstat(fd, &fileInfo) == 0 && static_cast<u64>(fileInfo.st_size) >= romSize)
+    {
+        void* mapping = mmap(nullptr, romSize, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (mapping != MAP_FAILED)
+            mappedData = static_cast<const u8*>(mapping);
+    }
+
+    close(fd); // The mapping keeps its own reference to the file
+}
+
+gb::MappedFileROMBankProvider::~MappedFileROMBankProvider()
+{
+    if (mappedData)
+        munmap(const_cast<u8*>(mappedData), romSize);
+}
+
+auto gb::MappedFileROMBankProvider::loadBank(u8 slot, u16 bank) -> const u8*
+{
+    return mappedData + bank * GB_ROM_BANK_SIZE;
+}
+
+#endif
@@ -1,7 +1,17 @@
 #include "mapper.h"
 
-gb::Mapper::Mapper(u8 numROMBanks)
-    : nROMBanks(numROMBanks)
+gb::Mapper::Mapper(u16 numROMBanks, u8 numRAMBanks)
+    : nROMBanks(numROMBanks), nRAMBanks(numRAMBanks)
 {
 
 }
+
+auto gb::Mapper::setROMBank(u8 slot, u16 bank) -> void
+{
+    romBankOffsets[slot] = (bank % nROMBanks) * convertKBToBytes(16);
+}
+
+auto gb::Mapper::setRAMBank(u8 bank) -> void
+{
+    ramBankOffset = (nRAMBanks > 0) ? (bank % nRAMBanks) * convertKBToBytes(8) : 0;
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2023 pabletefest
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#include "mbc1.h"
+
+gb::MBC1Mapper::MBC1Mapper(u16 numROMBanks, u8 numRAMBanks)
+    : Mapper(numROMBanks, numRAMBanks)
+{
+    updateBanks();
+}
+
+auto gb::MBC1Mapper::writeRegister(u16 addr, u8 data) -> void
+{
+    if (addr <= 0x1FFF) // RAM enable
+    {
+        ramEnabled = (data & 0x0F) == 0x0A;
+        return;
+    }
+    else if (addr <= 0x3FFF) // ROM bank number (lower 5 bits), bank 0 behaves as bank 1
+    {
+        romBankLowBits = data & 0x1F;
+
+        if (romBankLowBits == 0)
+            romBankLowBits = 1;
+    }
+    else if (addr <= 0x5FFF) // RAM bank number or upper bits of ROM bank number
+    {
+        bankHighBits = data & 0x03;
+    }
+    else if (addr <= 0x7FFF) // Banking mode select
+    {
+        bankingMode = data & 0x01;
+    }
+
+    updateBanks();
+}
+
+auto gb::MBC1Mapper::updateBanks() -> void
+{
+    setROMBank(0, bankingMode ? (bankHighBits << 5) : 0);
+    setROMBank(1, (bankHighBits << 5) | romBankLowBits);
+    setRAMBank(bankingMode ? bankHighBits : 0);
+}
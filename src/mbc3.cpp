@@ -0,0 +1,194 @@
+/*
+ * Copyright (C) 2023 pabletefest
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#include "mbc3.h"
+
+#include <cstring>
+#include <ctime>
+
+gb::MBC3Mapper::MBC3Mapper(u16 numROMBanks, u8 numRAMBanks, bool hasRTC)
+    : Mapper(numROMBanks, numRAMBanks), hasRTC(hasRTC)
+{
+    setROMBank(1, romBank);
+    setRAMBank(0);
+}
+
+auto gb::MBC3Mapper::writeRegister(u16 addr, u8 data) -> void
+{
+    if (addr <= 0x1FFF) // RAM and RTC registers enable
+    {
+        ramEnabled = (data & 0x0F) == 0x0A;
+    }
+    else if (addr <= 0x3FFF) // ROM bank number, bank 0 behaves as bank 1
+    {
+        romBank = data & 0x7F;
+
+        if (romBank == 0)
+            romBank = 1;
+
+        setROMBank(1, romBank);
+    }
+    else if (addr <= 0x5FFF) // RAM bank number (0x00-0x03) or RTC register select (0x08-0x0C)
+    {
+        ramBankOrRTCSelect = data & 0x0F;
+        ramBankSelected = ramBankOrRTCSelect <= 0x03;
+
+        if (ramBankSelected)
+            setRAMBank(ramBankOrRTCSelect);
+    }
+    else if (addr <= 0x7FFF) // Latch clock data, writing 0x00 and then 0x01 copies the clock to the readable registers
+    {
+        if (hasRTC && latchRegister == 0x00 && data == 0x01)
+        {
+            syncRTC();
+            std::memcpy(rtcLatchedRegisters, rtcRegisters, sizeof(rtcRegisters));
+        }
+
+        latchRegister = data;
+    }
+}
+
+auto gb::MBC3Mapper::readRAMRegister(u16 addr, u8& data) -> bool
+{
+    if (!hasRTC || ramBankOrRTCSelect < 0x08 || ramBankOrRTCSelect > 0x0C)
+        return false;
+
+    data = ramEnabled ? rtcLatchedRegisters[ramBankOrRTCSelect - 0x08] : 0xFF;
+    return true;
+}
+
+auto gb::MBC3Mapper::writeRAMRegister(u16 addr, u8 data) -> bool
+{
+    if (!hasRTC || ramBankOrRTCSelect < 0x08 || ramBankOrRTCSelect > 0x0C)
+        return false;
+
+    if (!ramEnabled)
+        return true;
+
+    // Time elapsed so far is accounted with the old values (and halt flag) before they change
+    syncRTC();
+
+    switch (ramBankOrRTCSelect - 0x08)
+    {
+    case Seconds:
+        rtcRegisters[Seconds] = data & 0x3F;
+        subSecondCycles = 0; // Writing the seconds resets the internal divider
+        break;
+    case Minutes:
+        rtcRegisters[Minutes] = data & 0x3F;
+        break;
+    case Hours:
+        rtcRegisters[Hours] = data & 0x1F;
+        break;
+    case DayLow:
+        rtcRegisters[DayLow] = data;
+        break;
+    case DayHigh:
+        rtcRegisters[DayHigh] = data & 0xC1;
+        break;
+    }
+
+    return true;
+}
+
+auto gb::MBC3Mapper::saveRTCState() -> RTCState
+{
+    syncRTC();
+
+    RTCState state;
+    std::memcpy(state.registers, rtcRegisters, sizeof(rtcRegisters));
+    std::memcpy(state.latchedRegisters, rtcLatchedRegisters, sizeof(rtcLatchedRegisters));
+    state.subSecondCycles = subSecondCycles;
+    state.hostTimestamp = static_cast<s64>(std::time(nullptr));
+
+    return state;
+}
+
+auto gb::MBC3Mapper::loadRTCState(const RTCState& state) -> void
+{
+    std::memcpy(rtcRegisters, state.registers, sizeof(rtcRegisters));
+    std::memcpy(rtcLatchedRegisters, state.latchedRegisters, sizeof(rtcLatchedRegisters));
+    subSecondCycles = state.subSecondCycles;
+    lastSyncTimestamp = cycleCounter ? *cycleCounter : 0;
+
+    s64 hostSecondsElapsed = static_cast<s64>(std::time(nullptr)) - state.hostTimestamp;
+
+    if ((rtcRegisters[DayHigh] & 0x40) == 0 && hostSecondsElapsed > 0)
+        advanceRTC(static_cast<u64>(hostSecondsElapsed));
+}
+
+auto gb::MBC3Mapper::syncRTC() -> void
+{
+    if (!cycleCounter)
+        return;
+
+    // The counter can go backwards when an older save state is restored, that time is simply not counted
+    u64 now = *cycleCounter;
+    u64 elapsedCycles = now > lastSyncTimestamp ? now - lastSyncTimestamp : 0;
+    lastSyncTimestamp = now;
+
+    if (rtcRegisters[DayHigh] & 0x40) // Halted
+        return;
+
+    u64 totalCycles = subSecondCycles + elapsedCycles;
+    subSecondCycles = static_cast<u32>(totalCycles % RTC_CYCLES_PER_SECOND);
+    advanceRTC(totalCycles / RTC_CYCLES_PER_SECOND);
+}
+
+auto gb::MBC3Mapper::advanceRTC(u64 seconds) -> void
+{
+    auto addDays = [this](u64 daysElapsed)
+    {
+        u64 days = rtcRegisters[DayLow] + ((rtcRegisters[DayHigh] & 0x01) << 8) + daysElapsed;
+
+        if (days > 0x1FF) // Day counter overflow sets the carry bit until the game clears it
+            rtcRegisters[DayHigh] |= 0x80;
+
+        days &= 0x1FF;
+        rtcRegisters[DayLow] = days & 0xFF;
+        rtcRegisters[DayHigh] = (rtcRegisters[DayHigh] & 0xFE) | static_cast<u8>(days >> 8);
+    };
+
+    // Out of range values written by the game count up to their bit width before wrapping (without carry),
+    // so those seconds are ticked one by one until every field is back in range
+    while (seconds > 0 && (rtcRegisters[Seconds] >= 60 || rtcRegisters[Minutes] >= 60 || rtcRegisters[Hours] >= 24))
+    {
+        seconds--;
+
+        rtcRegisters[Seconds] = (rtcRegisters[Seconds] + 1) & 0x3F;
+
+        if (rtcRegisters[Seconds] != 60)
+            continue;
+
+        rtcRegisters[Seconds] = 0;
+        rtcRegisters[Minutes] = (rtcRegisters[Minutes] + 1) & 0x3F;
+
+        if (rtcRegisters[Minutes] != 60)
+            continue;
+
+        rtcRegisters[Minutes] = 0;
+        rtcRegisters[Hours] = (rtcRegisters[Hours] + 1) & 0x1F;
+
+        if (rtcRegisters[Hours] != 24)
+            continue;
+
+        rtcRegisters[Hours] = 0;
+        addDays(1);
+    }
+
+    if (seconds == 0)
+        return;
+
+    u64 total = rtcRegisters[Seconds] + 60 * (rtcRegisters[Minutes] + 60 * rtcRegisters[Hours]) + seconds;
+
+    rtcRegisters[Seconds] = total % 60;
+    total /= 60;
+    rtcRegisters[Minutes] = total % 60;
+    total /= 60;
+    rtcRegisters[Hours] = total % 24;
+    addDays(total / 24);
+}
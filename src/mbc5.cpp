@@ -0,0 +1,37 @@
+/*
+ * Copyright (C) 2023 pabletefest
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#include "mbc5.h"
+
+gb::MBC5Mapper::MBC5Mapper(u16 numROMBanks, u8 numRAMBanks)
+    : Mapper(numROMBanks, numRAMBanks)
+{
+    setROMBank(1, romBank);
+    setRAMBank(0);
+}
+
+auto gb::MBC5Mapper::writeRegister(u16 addr, u8 data) -> void
+{
+    if (addr <= 0x1FFF) // RAM enable
+    {
+        ramEnabled = (data & 0x0F) == 0x0A;
+    }
+    else if (addr <= 0x2FFF) // ROM bank number (lower 8 bits)
+    {
+        romBank = (romBank & 0x100) | data;
+        setROMBank(1, romBank);
+    }
+    else if (addr <= 0x3FFF) // ROM bank number (9th bit)
+    {
+        romBank = (romBank & 0x0FF) | ((data & 0x01) << 8);
+        setROMBank(1, romBank);
+    }
+    else if (addr <= 0x5FFF) // RAM bank number
+    {
+        setRAMBank(data & 0x0F);
+    }
+}
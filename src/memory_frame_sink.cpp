@@ -0,0 +1,42 @@
+/*
+ * Copyright (C) 2023 pabletefest
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#include "memory_frame_sink.h"
+
+auto gb::MemoryFrameSink::drawPixel(s32 x, s32 y, u32 color) -> void
+{
+    if (x < 0 || x >= GB_PIXELS_WIDTH || y < 0 || y >= GB_PIXELS_HEIGHT)
+        return;
+
+    pixels[y * GB_PIXELS_WIDTH + x] = static_cast<u16>(color);
+}
+
+auto gb::MemoryFrameSink::readPixelValue(s32 x, s32 y) -> u16
+{
+    if (x < 0 || x >= GB_PIXELS_WIDTH || y < 0 || y >= GB_PIXELS_HEIGHT)
+        return 0;
+
+    return pixels[y * GB_PIXELS_WIDTH + x];
+}
+
+auto gb::MemoryFrameSink::getPixelsBufferData() -> u8*
+{
+    return reinterpret_cast<u8*>(pixels.data());
+}
+
+auto gb::MemoryFrameSink::presentFrame() -> void
+{
+    framesPresented++;
+}
+
+auto gb::MemoryFrameSink::printText(const std::string&, u8, u8) -> void
+{
+}
+
+auto gb::MemoryFrameSink::printText(const std::string&, u16, u16, u8, u8) -> void
+{
+}
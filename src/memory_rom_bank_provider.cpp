@@ -0,0 +1,18 @@
+/*
+ * Copyright (C) 2023 pabletefest
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#include "memory_rom_bank_provider.h"
+
+gb::MemoryROMBankProvider::MemoryROMBankProvider(std::vector<u8>&& romData)
+    : vROMMemory(std::move(romData))
+{
+}
+
+auto gb::MemoryROMBankProvider::loadBank(u8 slot, u16 bank) -> const u8*
+{
+    return vROMMemory.data() + bank * GB_ROM_BANK_SIZE;
+}
@@ -7,29 +7,13 @@
 
 #include "no_mbc.h"
 
-gb::NoMBCMapper::NoMBCMapper(u8 numROMBanks)
-    : Mapper(numROMBanks)
+gb::NoMBCMapper::NoMBCMapper(u16 numROMBanks, u8 numRAMBanks)
+    : Mapper(numROMBanks, numRAMBanks)
 {
+    ramEnabled = true; // Optional RAM is always accessible without a MBC
 }
 
-auto gb::NoMBCMapper::mapRead(u16 addr, u16& mapped_addr) -> bool
+auto gb::NoMBCMapper::writeRegister(u16 addr, u8 data) -> void
 {
-    if (addr >= 0x0000 && addr <= 0x7FFF)
-    {
-        mapped_addr = addr;
-        return true;
-    }
-
-    return false;
-}
-
-auto gb::NoMBCMapper::mapWrite(u16 addr, u16& mapped_addr, u8 data) -> bool
-{
-    /*if (addr >= 0x0000 && addr <= 0x7FFF)
-    {
-        mapped_addr = addr;
-        return true;
-    }*/
-
-    return false;
+    // No registers, ROM is fixed at banks 0 and 1 and RAM (if any) at bank 0
 }
@@ -0,0 +1,39 @@
+/*
+ * Copyright (C) 2023 pabletefest
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#include "partition_rom_bank_provider.h"
+
+#ifdef ESP32
+
+gb::PartitionROMBankProvider::PartitionROMBankProvider(const char* label)
+{
+    const esp_partition_t* partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+
+    if (!partition)
+        return;
+
+    const void* mapping = nullptr;
+
+    if (esp_partition_mmap(partition, 0, partition->size, SPI_FLASH_MMAP_DATA, &mapping, &mapHandle) == ESP_OK)
+    {
+        mappedData = static_cast<const u8*>(mapping);
+        partitionSize = partition->size;
+    }
+}
+
+gb::PartitionROMBankProvider::~PartitionROMBankProvider()
+{
+    if (mappedData)
+        spi_flash_munmap(mapHandle);
+}
+
+auto gb::PartitionROMBankProvider::loadBank(u8 slot, u16 bank) -> const u8*
+{
+    return mappedData + bank * GB_ROM_BANK_SIZE;
+}
+
+#endif
@@ -7,12 +7,12 @@
 
 #include "ppu.h"
 #include "gb.h"
+#include "scheduler.h"
+#include "memory_frame_sink.h"
+#include "tft_frame_sink.h"
 
 #include <cstring>
 
-#define GB_PIXELS_WIDTH 160
-#define GB_PIXELS_HEIGHT 144
-
 namespace gb
 {
     // "$8800 (LCD Control bit 4 is 0) and $8000 (LCD Control bit 4 is 1) addressing modes to access BG and Window Tile Data"
@@ -44,16 +44,11 @@ namespace gb
 gb::PPU::PPU(GBConsole* device)
     : system(device), LCDControl({}), LCDStatus({})
 {
-    display.init();
-    display.setRotation(1);
-    display.resetViewport();
-    display.fillScreen(TFT_BLACK);
-    screenSprite.setRotation(1);
-    screenSprite.resetViewport();
-    screenSprite.setColorDepth(16);
-    screenSprite.createSprite(GB_PIXELS_WIDTH, GB_PIXELS_HEIGHT);
-    screenSprite.fillScreen(TFT_BLACK);
-    screenSprite.createPalette(greenShadesRGB565Palette, 4);
+#ifdef ESP32
+    screen = std::make_unique<TFTFrameSink>(greenShadesRGB565Palette, 4);
+#else
+    screen = std::make_unique<MemoryFrameSink>();
+#endif
     // std::memset(VRAM.data(), 0x00, VRAM.size());
     std::memset(OAM.data(), 0x00, OAM.size() * sizeof(SpriteInfoOAM));
     std::memset(scanlineValidSprites.data(), 0x00, scanlineValidSprites.size() * sizeof(SpriteInfoOAM));
@@ -75,7 +70,7 @@ auto gb::PPU::read(u16 address) -> u8
         /*if (LCDStatus.ModeFlag == 3 || LCDStatus.ModeFlag == 2)
             return 0xFF;*/
 
-        dataRead = reinterpret_cast<u8*>(OAM.data())[address & 0x9F];
+        dataRead = reinterpret_cast<u8*>(OAM.data())[address - 0xFE00];
     }
     else
     {
@@ -131,14 +126,28 @@ auto gb::PPU::write(u16 address, u8 data) -> void
         /*if (LCDStatus.ModeFlag == 3 || LCDStatus.ModeFlag == 2)
             return;*/
 
-        reinterpret_cast<u8*>(OAM.data())[address & 0x9F] = data;
+        reinterpret_cast<u8*>(OAM.data())[address - 0xFE00] = data;
     }
     else
     {
         switch (address)
         {
         case 0xFF40:
-            LCDControl.reg = data;
+            {
+                bool wasEnabled = LCDControl.LCDenable;
+                LCDControl.reg = data;
+
+                if (!wasEnabled && LCDControl.LCDenable) // Turning the LCD on starts over from line 0
+                {
+                    LY = 0x00;
+                    startScanline(system->getCyclesElapsed());
+                }
+                else if (wasEnabled && !LCDControl.LCDenable)
+                {
+                    LY = 0x00;
+                    stopScanlineEvents();
+                }
+            }
             break;
         case 0xFF41:
             LCDStatus.reg |= (data & 0x78); // Only bits 6, 5, 4, and 3 are writable
@@ -175,111 +184,118 @@ auto gb::PPU::reset() -> void
 {
 }
 
-auto gb::PPU::clock() -> void
+auto gb::PPU::onNewLineEvent(u64 timestamp) -> void
 {
-    if (!LCDControl.LCDenable)
-        return;
+    LY++;
+    // Serial.printf("LY: %d\n", LY);
 
-    //checkAndRaiseStatInterrupts();
-   
-    if (LY >= 0 && LY <= 143)
+    if (LY == 154)
     {
-        if (currentDot == 0)
-        {
-            if (LYC == LY)
-                LCDStatus.LYCLY_Flag = 1;
-            else
-                LCDStatus.LYCLY_Flag = 0;
+        LY = 0;
+        frameCompleted = true;
+        // static unsigned frameCount = 0;
+        // Serial.printf("Frame #%d completed!\n", frameCount++);
+    }
 
-            checkAndRaiseStatInterrupts();
-        }
+    startScanline(timestamp);
+}
 
-        // Mode 2 (OAM search)
-        if (currentDot >= 0 && currentDot <= 79)
-        {
-            if (currentDot == 0)
-            {
-                LCDStatus.ModeFlag = 2;
-                lastMode3Dot = 172 + 80 - 1; // Min number of dots is 168-174 according to different sources (172 placeholder for now)
-                // Serial.println("Mode 2 entered");
-            }
+auto gb::PPU::onMode3Event(u64 timestamp) -> void
+{
+    // Checking for valid objects in the current scanline performed at the end of mode 2
+    scanlineOAMScanSearchRoutine();
 
-            if (currentDot == 79) // Checking for valid objects in the current scanline performed in the last cycle of mode 2
-                scanlineOAMScanSearchRoutine();
+    LCDStatus.ModeFlag = 3;
+    //checkAndRaiseStatInterrupts();
+    // Serial.println("Mode 3 entered");
 
-            //checkAndRaiseStatInterrupts();
-        }
+    system->getScheduler().schedule(EventType::PPUHBlank, timestamp + (lastMode3Dot + 1 - 80));
+}
 
-        // Mode 3 (Rendering picture)
-        if (currentDot >= 80 && currentDot <= lastMode3Dot)
-        {
-            if (currentDot == 80)
-            {
-                LCDStatus.ModeFlag = 3;
-                //checkAndRaiseStatInterrupts();
-                // Serial.println("Mode 3 entered");
-            }
+auto gb::PPU::getNextOAMScanTimestamp() const -> u64
+{
+    const Scheduler& scheduler = system->getScheduler();
+    u64 mode3Deadline = scheduler.getDeadline(EventType::PPUMode3);
 
-            // Render the line in the last dot before HBlank (scanline renderer)
-            if (currentDot == lastMode3Dot)
-            {
-                if (LCDControl.BGWindEnablePriority)
-                {
-                    renderBackground();
-                    renderWindow();
-                }
+    if (mode3Deadline != Scheduler::NO_EVENT)
+        return mode3Deadline;
 
-                if (LCDControl.OBJenable)
-                    renderSprites();
-            }
-        }
+    u64 newLineDeadline = scheduler.getDeadline(EventType::PPUNewLine);
 
-        // Mode 0 (HBlank period)
-        //if ((currentDot >= (lastMode3Dot + 1)) && (currentDot <= (remainingDots - 1)))
-        if ((currentDot >= (lastMode3Dot + 1)) && (currentDot <= (totalDotsPerScanline - 1)))
-        {
-            if (currentDot == (lastMode3Dot + 1))
-            {
-                LCDStatus.ModeFlag = 0;
-                //checkAndRaiseStatInterrupts();
-                // Serial.println("Mode 0 entered");
-            }
-        }
-    }
-    else
+    if (newLineDeadline == Scheduler::NO_EVENT)
+        return Scheduler::NO_EVENT;
+
+    // Lines still to go in VBlank before the next visible one (LY wraps from 153 to 0)
+    u8 nextLY = (LY + 1) % 154;
+    u32 linesToWait = (nextLY < 144) ? 0 : 154 - nextLY;
+
+    return newLineDeadline + linesToWait * totalDotsPerScanline + 80;
+}
+
+auto gb::PPU::onHBlankEvent() -> void
+{
+    // Render the whole line when mode 3 ends (scanline renderer)
+    if (LCDControl.BGWindEnablePriority)
     {
-        // Mode 1 (VBlank period)
-        if (LY == 144 && currentDot == 0)
-        {
-            LCDStatus.ModeFlag = 1;
-            system->requestInterrupt(gb::GBConsole::InterruptType::VBlank);
-            // Serial.println("Mode 0 entered");
-        }
+        renderBackground();
+        renderWindow();
     }
 
-    currentDot++;
-    remainingDots--;
+    if (LCDControl.OBJenable)
+        renderSprites();
 
-    if (currentDot == 456)
+    LCDStatus.ModeFlag = 0;
+    //checkAndRaiseStatInterrupts();
+    // Serial.println("Mode 0 entered");
+}
+
+auto gb::PPU::startScanline(u64 timestamp) -> void
+{
+    Scheduler& scheduler = system->getScheduler();
+
+    if (LY <= 143)
     {
-        currentDot = 0;
-        remainingDots = 456;
-        LY++;
-        // Serial.printf("LY: %d\n", LY);
+        if (LYC == LY)
+            LCDStatus.LYCLY_Flag = 1;
+        else
+            LCDStatus.LYCLY_Flag = 0;
 
-        if (LY == 154)
-        {
-            LY = 0;
-            frameCompleted = true;
-            // static unsigned frameCount = 0;
-            // Serial.printf("Frame #%d completed!\n", frameCount++);
-        }
+        checkAndRaiseStatInterrupts();
+
+        // Mode 2 (OAM search)
+        LCDStatus.ModeFlag = 2;
+        lastMode3Dot = 172 + 80 - 1; // Min number of dots is 168-174 according to different sources (172 placeholder for now)
+        // Serial.println("Mode 2 entered");
+
+        scheduler.schedule(EventType::PPUMode3, timestamp + 80);
+    }
+    else if (LY == 144)
+    {
+        // Mode 1 (VBlank period)
+        LCDStatus.ModeFlag = 1;
+        system->requestInterrupt(gb::GBConsole::InterruptType::VBlank);
     }
+
+    scheduler.schedule(EventType::PPUNewLine, timestamp + totalDotsPerScanline);
+}
+
+auto gb::PPU::stopScanlineEvents() -> void
+{
+    Scheduler& scheduler = system->getScheduler();
+
+    scheduler.cancel(EventType::PPUMode3);
+    scheduler.cancel(EventType::PPUHBlank);
+    scheduler.cancel(EventType::PPUNewLine);
 }
 
 auto gb::PPU::getPixelsBufferData() -> u8 *
 {
-    return reinterpret_cast<u8 *>(getSpriteBuffer().getPointer());
+    return screen->getPixelsBufferData();
+}
+
+auto gb::PPU::setFrameSink(Scope<FrameSink> sink) -> void
+{
+    screen = std::move(sink);
 }
 
 auto gb::PPU::checkAndRaiseStatInterrupts() -> void
@@ -330,32 +346,32 @@ auto gb::PPU::renderBackground() -> void
             u8 x = (tileIndex * 8 + pixelIndex);
             // std::size_t bufferIndex = (LY * PIXELS_PER_LINE) + (tileIndex * 8 + pixelIndex);
 
-            // u8* pixelsBuffer = reinterpret_cast<u8*>(screenSprite.getPointer());
+            // u8* pixelsBuffer = reinterpret_cast<u8*>(screen->getPointer());
 
-            switch(screenSprite.getColorDepth())
+            switch(screen->getColorDepth())
             {
             case BBP1:
                 break;
             case BBP4:
             {
                 u8 colorIndex = colorPixel & 0b11;
-                screenSprite.drawPixel(x * 2, y * 2, colorIndex);
-                screenSprite.drawPixel(x * 2 + 1, y * 2, colorIndex);
-                screenSprite.drawPixel(x * 2, y * 2 + 1, colorIndex);
-                screenSprite.drawPixel(x * 2 + 1, y * 2 +1, colorIndex);
+                screen->drawPixel(x * 2, y * 2, colorIndex);
+                screen->drawPixel(x * 2 + 1, y * 2, colorIndex);
+                screen->drawPixel(x * 2, y * 2 + 1, colorIndex);
+                screen->drawPixel(x * 2 + 1, y * 2 +1, colorIndex);
             }
                 break;
             case BBP8:
             {
                 u8 paletteColor = (LCDControl.BGWindEnablePriority) ? greenShadesRGB332Palette[colorPixel & 0b11] : greenShadesRGB332Palette[0];
                 // pixelsBuffer[bufferIndex] = std::move(paletteColor);
-                screenSprite.drawPixel(x, y, paletteColor);
+                screen->drawPixel(x, y, paletteColor);
             }
                 break;
             case BBP16:
             {
                 u16 paletteColor = (LCDControl.BGWindEnablePriority) ? greenShadesRGB565Palette[colorPixel & 0b11] : greenShadesRGB565Palette[0];
-                screenSprite.drawPixel(x, y, paletteColor);
+                screen->drawPixel(x, y, paletteColor);
             }
                 break;
             case INVALID_BPP:
@@ -406,9 +422,9 @@ auto gb::PPU::renderSprites() -> void
             u8 x = (obj.Xposition - 8 + pixelIndex);
             // std::size_t bufferIndex = (LY * PIXELS_PER_LINE) + (obj.Xposition - 8 + pixelIndex);
 
-            // u8* pixelsBuffer = reinterpret_cast<u8*>(screenSprite.getPointer());
+            // u8* pixelsBuffer = reinterpret_cast<u8*>(screen->getPointer());
 
-            u8 colorDepth = screenSprite.getColorDepth();
+            u8 colorDepth = screen->getColorDepth();
             u16 bgColor = greenShadesRGB565Palette[0];
 
             if (colorDepth == BBP8)
@@ -417,12 +433,12 @@ auto gb::PPU::renderSprites() -> void
 
             if (colorDepth == BBP4)
             {
-                if ((obj.attributesFlags & 0x80) && (greenShadesRGB565Palette[screenSprite.readPixelValue(x * 2, y * 2)] != bgColor))
+                if ((obj.attributesFlags & 0x80) && (greenShadesRGB565Palette[screen->readPixelValue(x * 2, y * 2)] != bgColor))
                     continue;
             }
             else
             {
-                if ((obj.attributesFlags & 0x80) && (screenSprite.readPixelValue(x, y) != bgColor))
+                if ((obj.attributesFlags & 0x80) && (screen->readPixelValue(x, y) != bgColor))
                     continue;
             }
 
@@ -433,23 +449,23 @@ auto gb::PPU::renderSprites() -> void
             case BBP4:
             {
                 u8 colorIndex = colorPixel & 0b11;
-                screenSprite.drawPixel(x * 2, y * 2, colorIndex);
-                screenSprite.drawPixel(x * 2 + 1, y * 2, colorIndex);
-                screenSprite.drawPixel(x * 2, y * 2 + 1, colorIndex);
-                screenSprite.drawPixel(x * 2 + 1, y * 2 +1, colorIndex);
+                screen->drawPixel(x * 2, y * 2, colorIndex);
+                screen->drawPixel(x * 2 + 1, y * 2, colorIndex);
+                screen->drawPixel(x * 2, y * 2 + 1, colorIndex);
+                screen->drawPixel(x * 2 + 1, y * 2 +1, colorIndex);
             }       
             break;
             case BBP8:
             {
                 u8 paletteColor = greenShadesRGB332Palette[colorPixel & 0b11];
                 // pixelsBuffer[bufferIndex] = std::move(paletteColor);
-                screenSprite.drawPixel(x, y, paletteColor);
+                screen->drawPixel(x, y, paletteColor);
             }
                 break;
             case BBP16:
             {
                 u16 paletteColor = greenShadesRGB565Palette[colorPixel & 0b11];              
-                screenSprite.drawPixel(x, y, paletteColor);
+                screen->drawPixel(x, y, paletteColor);
             }
                 break;
             case INVALID_BPP:
@@ -479,43 +495,15 @@ auto gb::PPU::scanlineOAMScanSearchRoutine() -> void
 
 auto gb::PPU::drawFrameToDisplay() -> void
 {
-    // screenSprite.fillSprite(TFT_RED);
-
-    // for (int y = 0; y < 144; y++)
-    // {
-    //     for (int x = 0; x < 160; x++)
-    //     {
-    //         screenSprite.drawPixel(x, y, greenShadesRGB565Palette[x%4]);
-    //     }
-    // }
-
-    // Serial.printf("Width: %d - Height: %d\n", screenSprite.width(), screenSprite.height());
-
-    u16 x = display.width() / 2 - screenSprite.width() / 2;
-    u16 y = display.height() / 2 - screenSprite.height() / 2;
-
-    if (screenSprite.getColorDepth() == BBP4)
-        y += (x / y) * 2; // Adding some padding between the texts and the sprite
-
-    screenSprite.pushSprite(x, y);
-    // screenSprite.pushSprite(display.width() / 2 - GB_PIXELS_WIDTH / 2, display.height() / 2 - GB_PIXELS_HEIGHT / 2);
-    // screenSprite.pushSprite(0, 0);
+    screen->presentFrame();
 }
 
 auto gb::PPU::printTextToDisplay(const std::string& text, u8 font, u8 datum) -> void
 {
-    display.setTextColor(TFT_WHITE, TFT_BLACK);
-    // display.setTextFont(font);
-    display.setTextDatum(datum);
-    // display.setCursor(0, 0);
-    display.println(text.c_str());
+    screen->printText(text, font, datum);
 }
 
 auto gb::PPU::printTextToDisplay(const std::string& text, u16 x, u16 y, u8 font, u8 datum) -> void
 {
-    display.setTextColor(TFT_WHITE, TFT_BLACK);
-    // display.setTextFont(font);
-    display.setTextDatum(datum);
-    // display.setCursor(0, 0);
-    display.drawString(text.c_str(), x, y, font);
-}
\ No newline at end of file
+    screen->printText(text, x, y, font, datum);
+}
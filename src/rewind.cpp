@@ -0,0 +1,224 @@
+/*
+ * Copyright (C) 2023 pabletefest
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#include "rewind.h"
+#include "gb.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+gb::RewindBuffer::RewindBuffer(u32 capacityBytes, u16 framesPerSnapshot)
+    : framesPerSnapshot(std::max<u16>(framesPerSnapshot, 1))
+{
+    storage.resize(capacityBytes);
+    records.resize(MAX_RECORDS);
+}
+
+auto gb::RewindBuffer::onFrameCompleted(GBConsole& console) -> bool
+{
+    if (++framesSinceSnapshot < framesPerSnapshot)
+        return false;
+
+    framesSinceSnapshot = 0;
+    capture(console);
+    return true;
+}
+
+auto gb::RewindBuffer::capture(GBConsole& console) -> void
+{
+    auto startTime = std::chrono::steady_clock::now();
+
+    console.saveState(capturedState);
+
+    // A different layout (e.g. another cartridge) can't be diffed against, history starts over
+    if (hasLatestState && capturedState.size() != latestState.size())
+        clear();
+
+    if (hasLatestState)
+    {
+        // Applying it to the captured state gives back the previous one
+        encodeDelta(capturedState, latestState);
+        pushRecord(deltaScratch);
+        stats.lastSnapshotBytes = static_cast<u32>(deltaScratch.size());
+    }
+    else
+    {
+        stats.lastSnapshotBytes = 0;
+    }
+
+    latestState.swap(capturedState);
+    hasLatestState = true;
+
+    auto endTime = std::chrono::steady_clock::now();
+
+    stats.lastCaptureMicros = static_cast<u32>(std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count());
+    stats.maxCaptureMicros = std::max(stats.maxCaptureMicros, stats.lastCaptureMicros);
+    stats.captures++;
+    stats.totalSnapshotBytes += stats.lastSnapshotBytes;
+    stats.snapshotsStored = recordCount + 1;
+    stats.bytesUsed = storageUsed;
+}
+
+auto gb::RewindBuffer::stepBack(GBConsole& console) -> bool
+{
+    if (!hasLatestState)
+        return false;
+
+    bool loaded = console.loadState(latestState.data(), static_cast<u32>(latestState.size()));
+
+    if (recordCount > 0)
+    {
+        popNewestRecord(deltaScratch);
+        applyDelta(latestState);
+    }
+    else
+    {
+        hasLatestState = false;
+    }
+
+    framesSinceSnapshot = 0;
+    stats.snapshotsStored = recordCount + (hasLatestState ? 1 : 0);
+    stats.bytesUsed = storageUsed;
+
+    return loaded;
+}
+
+auto gb::RewindBuffer::clear() -> void
+{
+    hasLatestState = false;
+    storageHead = 0;
+    storageUsed = 0;
+    firstRecord = 0;
+    recordCount = 0;
+    stats.snapshotsStored = 0;
+    stats.bytesUsed = 0;
+}
+
+auto gb::RewindBuffer::encodeDelta(const std::vector<u8>& from, const std::vector<u8>& to) -> void
+{
+    // Sequence of [u16 zero run][u16 literal count][literal XOR bytes]. Most of the state doesn't change
+    // between snapshots, so long zero runs are skipped a word at a time.
+    deltaScratch.clear();
+
+    const u32 size = static_cast<u32>(from.size());
+    u32 i = 0;
+
+    while (i < size)
+    {
+        u32 zeroRun = 0;
+
+        while (i + sizeof(u64) <= size && zeroRun + sizeof(u64) <= 0xFFFF)
+        {
+            u64 a, b;
+            std::memcpy(&a, from.data() + i, sizeof(u64));
+            std::memcpy(&b, to.data() + i, sizeof(u64));
+
+            if (a != b)
+                break;
+
+            zeroRun += sizeof(u64);
+            i += sizeof(u64);
+        }
+
+        while (i < size && zeroRun < 0xFFFF && from[i] == to[i])
+        {
+            zeroRun++;
+            i++;
+        }
+
+        u32 literalStart = i;
+
+        // A literal ends at the first pair of equal bytes, a lone one is cheaper to store than a new run header
+        while (i < size && i - literalStart < 0xFFFF)
+        {
+            if (from[i] == to[i] && (i + 1 >= size || from[i + 1] == to[i + 1]))
+                break;
+
+            i++;
+        }
+
+        u16 header[2] = { static_cast<u16>(zeroRun), static_cast<u16>(i - literalStart) };
+        size_t offset = deltaScratch.size();
+        deltaScratch.resize(offset + sizeof(header) + header[1]);
+        std::memcpy(deltaScratch.data() + offset, header, sizeof(header));
+
+        u8* literal = deltaScratch.data() + offset + sizeof(header);
+
+        for (u32 j = literalStart; j < i; j++)
+            *literal++ = from[j] ^ to[j];
+    }
+}
+
+auto gb::RewindBuffer::applyDelta(std::vector<u8>& state) -> void
+{
+    const u8* delta = deltaScratch.data();
+    const u8* deltaEnd = delta + deltaScratch.size();
+    u32 position = 0;
+
+    while (delta < deltaEnd)
+    {
+        u16 header[2];
+        std::memcpy(header, delta, sizeof(header));
+        delta += sizeof(header);
+
+        position += header[0];
+
+        for (u32 j = 0; j < header[1]; j++)
+            state[position++] ^= *delta++;
+    }
+}
+
+auto gb::RewindBuffer::pushRecord(const std::vector<u8>& data) -> void
+{
+    const u32 size = static_cast<u32>(data.size());
+
+    // Bigger than the whole buffer, nothing older can be chained to the newest snapshot anymore
+    if (size > storage.size())
+    {
+        while (recordCount > 0)
+            dropOldestRecord();
+
+        return;
+    }
+
+    while (recordCount > 0 && (storageUsed + size > storage.size() || recordCount == MAX_RECORDS))
+        dropOldestRecord();
+
+    // Copied in two pieces when it wraps around the end of the ring
+    u32 firstPart = std::min<u32>(size, static_cast<u32>(storage.size()) - storageHead);
+    std::memcpy(storage.data() + storageHead, data.data(), firstPart);
+    std::memcpy(storage.data(), data.data() + firstPart, size - firstPart);
+
+    records[(firstRecord + recordCount) % MAX_RECORDS] = { storageHead, size };
+    recordCount++;
+
+    storageHead = (storageHead + size) % storage.size();
+    storageUsed += size;
+}
+
+auto gb::RewindBuffer::dropOldestRecord() -> void
+{
+    storageUsed -= records[firstRecord].size;
+    firstRecord = (firstRecord + 1) % MAX_RECORDS;
+    recordCount--;
+}
+
+auto gb::RewindBuffer::popNewestRecord(std::vector<u8>& data) -> void
+{
+    const Record& record = records[(firstRecord + recordCount - 1) % MAX_RECORDS];
+
+    data.resize(record.size);
+
+    u32 firstPart = std::min<u32>(record.size, static_cast<u32>(storage.size()) - record.offset);
+    std::memcpy(data.data(), storage.data() + record.offset, firstPart);
+    std::memcpy(data.data() + firstPart, storage.data(), record.size - firstPart);
+
+    storageHead = record.offset;
+    storageUsed -= record.size;
+    recordCount--;
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2023 pabletefest
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#include "scheduler.h"
+
+gb::Scheduler::Scheduler()
+{
+    reset();
+}
+
+auto gb::Scheduler::schedule(EventType type, u64 timestamp) -> void
+{
+    u64 previousDeadline = deadlines[static_cast<u8>(type)];
+    deadlines[static_cast<u8>(type)] = timestamp;
+
+    if (timestamp <= nextDeadline)
+        nextDeadline = timestamp;
+    else if (previousDeadline == nextDeadline) // The earliest event was pushed back
+        updateNextDeadline();
+}
+
+auto gb::Scheduler::cancel(EventType type) -> void
+{
+    u64 previousDeadline = deadlines[static_cast<u8>(type)];
+    deadlines[static_cast<u8>(type)] = NO_EVENT;
+
+    if (previousDeadline == nextDeadline)
+        updateNextDeadline();
+}
+
+auto gb::Scheduler::reset() -> void
+{
+    deadlines.fill(NO_EVENT);
+    nextDeadline = NO_EVENT;
+}
+
+auto gb::Scheduler::popDueEvent(u64 currentTimestamp, EventType& type, u64& timestamp) -> bool
+{
+    if (nextDeadline > currentTimestamp)
+        return false;
+
+    // Ties are resolved by slot order
+    for (u8 slot = 0; slot < deadlines.size(); slot++)
+    {
+        if (deadlines[slot] == nextDeadline)
+        {
+            type = static_cast<EventType>(slot);
+            timestamp = deadlines[slot];
+            deadlines[slot] = NO_EVENT;
+            updateNextDeadline();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+auto gb::Scheduler::updateNextDeadline() -> void
+{
+    nextDeadline = NO_EVENT;
+
+    for (u64 deadline : deadlines)
+    {
+        if (deadline < nextDeadline)
+            nextDeadline = deadline;
+    }
+}
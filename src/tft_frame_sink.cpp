@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2023 pabletefest
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#include "tft_frame_sink.h"
+
+#ifdef ESP32
+
+gb::TFTFrameSink::TFTFrameSink(const u16* palette, u8 paletteSize)
+{
+    display.init();
+    display.setRotation(1);
+    display.resetViewport();
+    display.fillScreen(TFT_BLACK);
+    screenSprite.setRotation(1);
+    screenSprite.resetViewport();
+    screenSprite.setColorDepth(16);
+    screenSprite.createSprite(GB_PIXELS_WIDTH, GB_PIXELS_HEIGHT);
+    screenSprite.fillScreen(TFT_BLACK);
+    screenSprite.createPalette(palette, paletteSize);
+}
+
+auto gb::TFTFrameSink::getPixelsBufferData() -> u8*
+{
+    return reinterpret_cast<u8 *>(screenSprite.getPointer());
+}
+
+auto gb::TFTFrameSink::presentFrame() -> void
+{
+    // screenSprite.fillSprite(TFT_RED);
+
+    // Serial.printf("Width: %d - Height: %d\n", screenSprite.width(), screenSprite.height());
+
+    u16 x = display.width() / 2 - screenSprite.width() / 2;
+    u16 y = display.height() / 2 - screenSprite.height() / 2;
+
+    if (screenSprite.getColorDepth() == 4) // 4 bpp paletted sprite
+        y += (x / y) * 2; // Adding some padding between the texts and the sprite
+
+    screenSprite.pushSprite(x, y);
+    // screenSprite.pushSprite(display.width() / 2 - GB_PIXELS_WIDTH / 2, display.height() / 2 - GB_PIXELS_HEIGHT / 2);
+    // screenSprite.pushSprite(0, 0);
+}
+
+auto gb::TFTFrameSink::printText(const std::string& text, u8 font, u8 datum) -> void
+{
+    display.setTextColor(TFT_WHITE, TFT_BLACK);
+    // display.setTextFont(font);
+    display.setTextDatum(datum);
+    // display.setCursor(0, 0);
+    display.println(text.c_str());
+}
+
+auto gb::TFTFrameSink::printText(const std::string& text, u16 x, u16 y, u8 font, u8 datum) -> void
+{
+    display.setTextColor(TFT_WHITE, TFT_BLACK);
+    // display.setTextFont(font);
+    display.setTextDatum(datum);
+    // display.setCursor(0, 0);
+    display.drawString(text.c_str(), x, y, font);
+}
+
+#endif
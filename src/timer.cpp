@@ -7,6 +7,7 @@
 
 #include "timer.h"
 #include "gb.h"
+#include "scheduler.h"
 
 static constexpr u32 CPU_CLOCK_SPEED = 4194304u;
 static constexpr u32 timaClockSpeeds[4] = { 4096u, 262144u, 65536u, 16384u };
@@ -21,6 +22,8 @@ auto gb::Timer::read(u16 address) -> u8
 {
     u8 dataRead = 0x00;
 
+    sync(system->getCyclesElapsed());
+
 	switch (address)
 	{
     case 0xFF04:
@@ -42,6 +45,11 @@ auto gb::Timer::read(u16 address) -> u8
 
 auto gb::Timer::write(u16 address, u8 data) -> void
 {
+    sync(system->getCyclesElapsed());
+
+    // Writes to DIV and TAC may drop the AND of the watched bit and the enable flag, which ticks TIMA
+    u8 previousANDResult = ((internalRegisterDIV >> watchedBitIndex()) & 1u) & timerControl.timerEnable;
+
     switch (address)
     {
     case 0xFF04:
@@ -57,46 +65,95 @@ auto gb::Timer::write(u16 address, u8 data) -> void
         timerControl.reg = data;
         break;
     }
+
+    u8 AND_Result = ((internalRegisterDIV >> watchedBitIndex()) & 1u) & timerControl.timerEnable;
+
+    if (previousANDResult == 1 && AND_Result == 0) // Falling edge occured
+        addTIMATicks(1);
+
+    scheduleOverflow();
+}
+
+auto gb::Timer::onOverflowEvent(u64 timestamp) -> void
+{
+    // The overflow itself is applied by sync(), the event makes sure it happens on time
+    sync(timestamp);
+    scheduleOverflow();
+}
+
+auto gb::Timer::setDIVtoSkippedBootromValue() -> void
+{
+    sync(system->getCyclesElapsed());
+    internalRegisterDIV = 0xABCC;
+    scheduleOverflow();
+}
+
+auto gb::Timer::sync(u64 timestamp) -> void
+{
+    if (timestamp <= lastSyncTimestamp)
+        return;
+
+    // Kept 64-bit: after a long pause (STOP, a host debugger) the gap can exceed 32 bits
+    u64 cycles = timestamp - lastSyncTimestamp;
+    lastSyncTimestamp = timestamp;
+
+    if (timerControl.timerEnable)
+    {
+        // The watched bit falls each time DIV crosses a multiple of 2^(bit + 1)
+        u8 shift = watchedBitIndex() + 1;
+        u64 divStart = internalRegisterDIV;
+        u64 divEnd = divStart + cycles;
+
+        addTIMATicks((divEnd >> shift) - (divStart >> shift));
+    }
+
+    internalRegisterDIV += static_cast<u16>(cycles);
 }
 
-auto gb::Timer::clock() -> void
+auto gb::Timer::addTIMATicks(u64 ticks) -> void
 {
-    internalRegisterDIV++;
+    // Every overflow reloads TMA, so whole reload periods only raise the interrupt again
+    u32 reloadPeriod = 0x100 - timerModulo;
 
-    u8 watchedBit = (internalRegisterDIV >> watchableInternalDIVbits[timerControl.inputClockSelect]) & 1u;
-    u8 timerEnable = timerControl.timerEnable & 1u;
-    u8 AND_Result = watchedBit & timerEnable;
+    if (ticks > 0x100 + reloadPeriod)
+        ticks = 0x100 - timerCounter + (ticks - (0x100 - timerCounter)) % reloadPeriod + reloadPeriod;
 
-    if (lastANDresult == 1 && AND_Result == 0) // Falling edge occured
+    while (ticks > 0)
     {
-        timerCounter++;
+        u32 ticksToOverflow = 0x100 - timerCounter;
 
-        if (timerCounter == 0x00) // TIMA overflowed
+        if (ticks < ticksToOverflow)
         {
-            timerCounter = timerModulo;
-            system->requestInterrupt(gb::GBConsole::InterruptType::Timer);
+            timerCounter += ticks;
+            break;
         }
+
+        // TIMA overflowed
+        ticks -= ticksToOverflow;
+        timerCounter = timerModulo;
+        system->requestInterrupt(gb::GBConsole::InterruptType::Timer);
+    }
+}
+
+auto gb::Timer::watchedBitIndex() const -> u8
+{
+    return watchableInternalDIVbits[timerControl.inputClockSelect];
+}
+
+auto gb::Timer::scheduleOverflow() -> void
+{
+    Scheduler& scheduler = system->getScheduler();
+
+    if (!timerControl.timerEnable)
+    {
+        scheduler.cancel(EventType::TimerOverflow);
+        return;
     }
 
-    lastANDresult = AND_Result;
-
-    //if (timerControl.timerEnable)
-    //{
-    //    if (cyclesElapsed == (CPU_CLOCK_SPEED / timaClockSpeeds[timerControl.inputClockSelect]))
-    //    {
-    //        if (timerCounter == 0xFF)
-    //        {
-    //            timerCounter = timerModulo;
-    //            system->requestInterrupt(gb::GBConsole::InterruptType::Timer);
-    //        }
-    //        else
-    //        {
-    //            timerCounter++;
-    //        }
-    //    }
-    //    else
-    //    {
-    //        cyclesElapsed++;
-    //    }
-    //}
+    // Cycles until the next falling edge, then one full period per remaining TIMA increment
+    u32 period = 1u << (watchedBitIndex() + 1);
+    u32 cyclesToNextEdge = period - (internalRegisterDIV & (period - 1));
+    u32 ticksToOverflow = 0x100 - timerCounter;
+
+    scheduler.schedule(EventType::TimerOverflow, lastSyncTimestamp + cyclesToNextEdge + (ticksToOverflow - 1) * period);
 }
@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2023 pabletefest
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#pragma once
+#include "test_support.h"
+
+#include <cstring>
+
+namespace gb::test
+{
+    // Synthetic game loop keeping every component busy: HALT between frames, VBlank/STAT/timer interrupts, OAM DMA
+    // from HRAM every frame, scrolling, and an ALU mix on the interrupt counters written into tile data
+    inline auto buildActivityROM() -> TestROM
+    {
+        TestROM rom;
+
+        // Interrupt vectors
+        rom.org(0x40);
+        rom.abs16(0xC3, "vblank");
+        rom.org(0x48);
+        rom.abs16(0xC3, "stat");
+        rom.org(0x50);
+        rom.abs16(0xC3, "timer");
+
+        std::memcpy(&rom[0x134], "FESTTEST", 8);
+
+        rom.org(0x150);
+        rom.emit({ 0xF3, 0x31, 0xFF, 0xDF });                                  // DI; LD SP,DFFF
+
+        // Tile data and map patterns
+        rom.emit({ 0x21, 0x00, 0x80 });                                        // LD HL,8000
+        rom.label("tiles");
+        rom.emit({ 0x7D, 0xAC, 0x22, 0x7C, 0xFE, 0x98 });                      // LD A,L; XOR H; LD (HL+),A; LD A,H; CP 98
+        rom.jr(0x20, "tiles");
+        rom.label("map");
+        rom.emit({ 0x7D, 0x22, 0x7C, 0xFE, 0x9C });                            // LD A,L; LD (HL+),A; LD A,H; CP 9C
+        rom.jr(0x20, "map");
+
+        // OAM source at C100
+        rom.emit({ 0x21, 0x00, 0xC1, 0x06, 160 });                             // LD HL,C100; LD B,160
+        rom.label("sprites");
+        rom.emit({ 0x78, 0x87, 0x22, 0x05 });                                  // LD A,B; ADD A; LD (HL+),A; DEC B
+        rom.jr(0x20, "sprites");
+
+        // OAM DMA routine copied to HRAM
+        rom.emit({ 0x21, 0x80, 0xFF });                                        // LD HL,FF80
+
+        for (u8 byte : { 0x3E, 0xC1, 0xE0, 0x46, 0x3E, 0x28, 0x3D, 0x20, 0xFD, 0xC9 })
+            rom.emit({ 0x3E, byte, 0x22 });                                    // LD A,byte; LD (HL+),A
+
+        rom.emit({ 0xAF, 0xEA, 0x00, 0xC0, 0xEA, 0x02, 0xC0 });                // Frame and timer counters cleared
+        rom.emit({ 0x3E, 0xE4, 0xE0, 0x47, 0xE0, 0x48, 0xE0, 0x49 });          // Palettes
+        rom.emit({ 0x3E, 0x05, 0xE0, 0x07, 0x3E, 0xF0, 0xE0, 0x06 });          // TAC = 262144 Hz, TMA = F0
+        rom.emit({ 0x3E, 0x40, 0xE0, 0x41, 0x3E, 0x50, 0xE0, 0x45 });          // STAT LYC interrupt, LYC = 0x50
+        rom.emit({ 0x3E, 0x07, 0xE0, 0xFF });                                  // IE = VBlank, STAT, timer
+        rom.emit({ 0x3E, 0x93, 0xE0, 0x40 });                                  // LCD on
+        rom.emit({ 0xFB });                                                    // EI
+
+        rom.label("main");
+        rom.emit({ 0x76, 0x00 });                                              // HALT
+        rom.abs16(0xCD, "compute");
+        rom.label("wait");
+        rom.emit({ 0xF0, 0x44, 0xFE, 0x10 });                                  // LDH A,(LY); CP 10
+        rom.jr(0x20, "wait");
+        rom.emit({ 0xFA, 0x00, 0xC0, 0xE0, 0x43 });                            // SCX = frame counter
+        rom.jr(0x18, "main");
+
+        rom.label("vblank");
+        rom.emit({ 0xF5, 0xCD, 0x80, 0xFF });                                  // PUSH AF; CALL FF80 (DMA)
+        rom.emit({ 0xFA, 0x00, 0xC0, 0x3C, 0xEA, 0x00, 0xC0, 0xF1, 0xD9 });    // Frame counter++; POP AF; RETI
+        rom.label("stat");
+        rom.emit({ 0xF5, 0xF0, 0x42, 0x3C, 0xE0, 0x42, 0xF1, 0xD9 });          // SCY++
+        rom.label("timer");
+        rom.emit({ 0xF5, 0xE5, 0x21, 0x02, 0xC0, 0x34, 0xE1, 0xF1, 0xD9 });    // Timer counter++
+
+        // ALU mix seeded from the counters
+        rom.label("compute");
+        rom.emit({ 0xFA, 0x00, 0xC0, 0x47 });
+        rom.emit({ 0xFA, 0x02, 0xC0, 0x4F });
+        rom.emit({ 0x11, 0x34, 0x12 });
+        rom.emit({ 0x78, 0x81, 0x27, 0x57 });
+        rom.emit({ 0x88, 0x99, 0x9A, 0xA3, 0xB4, 0xAD, 0xBA, 0x27, 0x5F });
+        rom.emit({ 0x2F, 0x37, 0x3F, 0x07, 0x17, 0x0F, 0x1F, 0x67 });
+        rom.emit({ 0x2E, 0x10 });
+        rom.emit({ 0xCB, 0x00, 0xCB, 0x09, 0xCB, 0x12, 0xCB, 0x1B, 0xCB, 0x24, 0xCB, 0x2D, 0xCB, 0x37, 0xCB, 0x38, 0xCB, 0x47,
+                   0xCB, 0x7C, 0xCB, 0xC1, 0xCB, 0x8A });
+        rom.emit({ 0x26, 0xC0 });
+        rom.emit({ 0x2E, 0x20, 0x77, 0xCB, 0x06, 0xCB, 0x16, 0xCB, 0x2E, 0xCB, 0x36, 0xCB, 0x46, 0xCB, 0xFE, 0x34, 0x35, 0x7E });
+        rom.emit({ 0x09, 0x19, 0x29, 0x39, 0x03, 0x13, 0x0B, 0x1B });
+        rom.emit({ 0xC5, 0xD5, 0xE5, 0xF5, 0xF1, 0xE1, 0xD1, 0xC1 });
+        rom.emit({ 0x08, 0x30, 0xC0 });
+        rom.emit({ 0xF8, 0x05, 0xE8, 0xFE, 0xE8, 0x02 });
+        rom.emit({ 0xC6, 0x37, 0xCE, 0x81, 0xD6, 0x13, 0xDE, 0x22, 0xE6, 0xF7, 0xEE, 0x5A, 0xF6, 0x01, 0xFE, 0x40 });
+
+        // Results stored, then scribbled into tile 1 so the frame depends on them
+        rom.emit({ 0xEA, 0x10, 0xC0, 0x78, 0xEA, 0x11, 0xC0, 0x79, 0xEA, 0x12, 0xC0, 0x7A, 0xEA, 0x13, 0xC0, 0x7B, 0xEA, 0x14, 0xC0 });
+        rom.emit({ 0x7C, 0xEA, 0x15, 0xC0, 0x7D, 0xEA, 0x16, 0xC0, 0xF5, 0xE1, 0x7D, 0xEA, 0x17, 0xC0 });
+        rom.emit({ 0xFA, 0x10, 0xC0, 0xEA, 0x10, 0x80, 0xFA, 0x13, 0xC0, 0xEA, 0x11, 0x80, 0xFA, 0x17, 0xC0, 0xEA, 0x12, 0x80,
+                   0xFA, 0x02, 0xC0, 0xEA, 0x13, 0x80 });
+
+        // Conditional flow
+        rom.emit({ 0xFE, 0x80 });
+        rom.jr(0x38, "skip");
+        rom.emit({ 0x3C });
+        rom.label("skip");
+        rom.abs16(0xDC, "sub");
+        rom.abs16(0xC4, "sub");
+        rom.emit({ 0xC9 });
+        rom.label("sub");
+        rom.emit({ 0x3C, 0xC8, 0xC0, 0xC9 });
+
+        return rom;
+    }
+}
@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2023 pabletefest
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+// Battery backed RAM and MBC3 clock persisted to the .sav file: coalesced flushes, reload, no write at all when
+// neither the RAM nor the clock registers changed, and the flush when a console lets go of its cartridge
+
+#include "test_support.h"
+
+#include <fstream>
+#include <iterator>
+
+static constexpr u64 FLUSH_WAIT_CYCLES = 2 * gb::MBC3Mapper::RTC_CYCLES_PER_SECOND; // Past GB_SAVE_FLUSH_INTERVAL
+static constexpr u32 RAM_SIZE = 0x8000;
+
+static const std::string ROM_PATH = "battery_save_test.gb";
+static const std::string SAVE_PATH = "battery_save_test.sav";
+
+static auto readSaveFile() -> std::vector<u8>
+{
+    std::ifstream ifs(SAVE_PATH, std::ifstream::binary);
+    return std::vector<u8>(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+}
+
+static auto overwriteSaveFileByte(u32 offset, u8 value) -> void
+{
+    std::fstream fs(SAVE_PATH, std::fstream::in | std::fstream::out | std::fstream::binary);
+    fs.seekp(offset);
+    fs.put(static_cast<char>(value));
+}
+
+static auto readRTCRegister(gb::GamePak& cartridge, u8 reg) -> u8
+{
+    u8 data = 0;
+    cartridge.write(0x6000, 0x00);
+    cartridge.write(0x6000, 0x01);
+    cartridge.write(0x4000, reg);
+    cartridge.read(0xA000, data);
+
+    return data;
+}
+
+int main()
+{
+    gb::test::TestROM rom(4, 0x10, 0x03); // MBC3+TIMER+RAM+BATTERY, 32 KiB of RAM
+    rom.writeFile(ROM_PATH);
+    std::remove(SAVE_PATH.c_str());
+
+    u64 cycles = 0;
+
+    {
+        gb::GamePak cartridge(ROM_PATH);
+        cartridge.connectCycleCounter(&cycles);
+
+        GB_CHECK(cartridge.tracksRAMWrites());
+
+        cartridge.write(0x0000, 0x0A); // RAM and clock enabled
+        cartridge.write(0x4000, 0x02);
+        cartridge.write(0xA123, 0x55);
+        cartridge.write(0x4000, 0x08);
+        cartridge.write(0xA000, 30); // Clock seconds
+
+        // Writes are coalesced, nothing goes out before the flush interval
+        cycles += 100;
+        cartridge.flushSaveIfDue();
+        GB_CHECK(readSaveFile().empty());
+
+        cycles += FLUSH_WAIT_CYCLES;
+        cartridge.flushSaveIfDue();
+        GB_CHECK_EQ(readSaveFile().size(), RAM_SIZE + sizeof(gb::MBC3Mapper::RTCState));
+
+        cartridge.write(0x4000, 0x00);
+        cartridge.write(0xA000, 0x77);
+        cartridge.write(0x4000, 0x0C);
+        cartridge.write(0xA000, 0x40); // Clock halted, so it reads the same on reload
+    }
+
+    {
+        gb::GamePak cartridge(ROM_PATH);
+        cartridge.connectCycleCounter(&cycles);
+
+        u8 data = 0;
+        cartridge.write(0x0000, 0x0A);
+        cartridge.write(0x4000, 0x02);
+        cartridge.read(0xA123, data);
+        GB_CHECK_EQ(data, 0x55);
+        cartridge.write(0x4000, 0x00);
+        cartridge.read(0xA000, data);
+        GB_CHECK_EQ(data, 0x77); // Written back by the destructor
+        GB_CHECK_EQ(readRTCRegister(cartridge, 0x08), 32); // 2 seconds ran before the halt
+        GB_CHECK_EQ(readRTCRegister(cartridge, 0x0C) & 0x40, 0x40);
+
+        // Clean RAM, halted clock: flushing must leave the file alone
+        cartridge.flushSave();
+        overwriteSaveFileByte(0, 0xEE);
+        overwriteSaveFileByte(RAM_SIZE, 0xEE);
+        cycles += FLUSH_WAIT_CYCLES;
+        cartridge.flushSave();
+        GB_CHECK_EQ(readSaveFile()[0], 0xEE);
+        GB_CHECK_EQ(readSaveFile()[RAM_SIZE], 0xEE);
+
+        // Only the clock changed: just the RTC tail is rewritten
+        cartridge.write(0x4000, 0x08);
+        cartridge.write(0xA000, 45);
+        cartridge.flushSave();
+
+        std::vector<u8> save = readSaveFile();
+        GB_CHECK_EQ(save[0], 0xEE);
+        GB_CHECK_EQ(save[RAM_SIZE], 45);
+    }
+
+    // A console flushes its cartridge when another one replaces it and when it goes away, which can outlive it
+    {
+        Ref<gb::GamePak> cartridge = std::make_shared<gb::GamePak>(ROM_PATH);
+        Scope<gb::GBConsole> console = std::make_unique<gb::GBConsole>();
+        console->insertCartridge(cartridge);
+
+        cartridge->write(0x0000, 0x0A);
+        cartridge->write(0x4000, 0x00);
+        cartridge->write(0xA010, 0x12);
+        console->insertCartridge(std::make_shared<gb::GamePak>(ROM_PATH));
+        GB_CHECK_EQ(readSaveFile()[0x10], 0x12);
+
+        console->insertCartridge(cartridge);
+        cartridge->write(0xA011, 0x34);
+        console.reset();
+        GB_CHECK_EQ(readSaveFile()[0x11], 0x34);
+
+        cartridge->write(0xA012, 0x56);
+        cartridge->flushSave();
+        GB_CHECK_EQ(readSaveFile()[0x12], 0x56);
+        GB_CHECK_EQ(readRTCRegister(*cartridge, 0x08), 45);
+    }
+
+    return gb::test::finish();
+}
@@ -0,0 +1,44 @@
+/*
+ * Copyright (C) 2023 pabletefest
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+// Runs a synthetic ROM through the boot ROM and 1200 frames of LCD, timer and DMA activity and checks the frame hash,
+// so every CPU dispatch and timing build (see CMakeLists.txt) is held to the same picture
+
+#include "activity_rom.h"
+
+#ifdef GB_CPU_M_CYCLE_ACCURATE
+// The boot ROM turns the LCD on with LDH (40),A, which writes on its 3rd M-cycle: the PPU runs 12 T-cycles later
+// against the timer, and from frame 343 on the timer interrupt count sampled into the tiles is one lower
+// (see m_cycle_timing_test.cpp)
+static constexpr u32 EXPECTED_FRAME_HASH = 0x69075311;
+#else
+static constexpr u32 EXPECTED_FRAME_HASH = 0xDE2DBB09;
+#endif
+
+static constexpr u32 FRAMES_TO_RUN = 1200;
+
+int main()
+{
+    gb::test::TestROM rom = gb::test::buildActivityROM();
+
+    Scope<gb::GBConsole> console = std::make_unique<gb::GBConsole>();
+    gb::test::loadTestROM(*console, rom, "frame_hash_test.gb");
+    gb::test::runFrames(*console, FRAMES_TO_RUN);
+
+    GB_CHECK(gb::test::bootROMFinished(*console));
+    GB_CHECK_EQ(gb::test::hashFrame(console->getPPU()), EXPECTED_FRAME_HASH);
+
+    // Ticking every component per T-cycle has to give the same picture as stepping whole instructions
+    Scope<gb::GBConsole> cycleStepped = std::make_unique<gb::GBConsole>();
+    gb::test::insertTestROM(*cycleStepped, "frame_hash_test.gb");
+    gb::test::runFrames(*cycleStepped, FRAMES_TO_RUN, true);
+
+    GB_CHECK(gb::test::bootROMFinished(*cycleStepped));
+    GB_CHECK_EQ(gb::test::hashFrame(cycleStepped->getPPU()), EXPECTED_FRAME_HASH);
+
+    return gb::test::finish();
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2023 pabletefest
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+// Where inside an instruction its bus access happens. On hardware LD (nn),A writes on its 4th M-cycle, LDH (n),A on
+// its 3rd and LD A,(C) reads on its 2nd. Each probe resets DIV with LD (FF04),A, enables TIMA at 262144 Hz (a tick
+// each time DIV's bit 3 falls, every 16 T-cycles after the reset) with LDH (07),A, and reads TIMA with LD A,(C).
+//
+// Counted from the DIV reset, hardware enables the timer at +36 and reads at +44, +52 and +60 for 0, 2 and 4 NOPs,
+// so TIMA reads 0, 1, 1 (ticks at +48, +64). Every read is a full M-cycle away from a tick, and the M-cycle build
+// gives those values. Instruction timing does each access at the start of its instruction, 16 T-cycles early for
+// the reset and 12 for the enable, and reads 1, 1, 2.
+//
+// The boot ROM's LDH (40),A has the same 12 T-cycle shift: with M-cycle timing the LCD starts that much later
+// against DIV, which is why frame_hash_test's picture differs between both timings
+
+#include "test_support.h"
+
+#include <array>
+
+static constexpr std::array<u8, 3> PROBE_NOPS = { 0, 2, 4 };
+
+#ifdef GB_CPU_M_CYCLE_ACCURATE
+static constexpr std::array<u8, 3> EXPECTED_TIMA = { 0, 1, 1 };
+#else
+static constexpr std::array<u8, 3> EXPECTED_TIMA = { 1, 1, 2 };
+#endif
+
+static auto buildTestROM() -> gb::test::TestROM
+{
+    gb::test::TestROM rom;
+
+    rom.emit({ 0xF3, 0x31, 0xFF, 0xDF });                                  // DI; LD SP,DFFF
+
+    for (u8 probe = 0; probe < PROBE_NOPS.size(); probe++)
+    {
+        rom.emit({ 0x0E, 0x05, 0xAF, 0xE0, 0x07 });                        // LD C,05; XOR A; TAC = 0
+        rom.emit({ 0xEA, 0x04, 0xFF });                                    // LD (FF04),A: DIV reset
+        rom.emit({ 0xE0, 0x05 });                                          // TIMA = 0
+        rom.emit({ 0x3E, 0x05, 0x00 });                                    // LD A,05; NOP
+        rom.emit({ 0xE0, 0x07 });                                          // TAC = 05: enabled, 262144 Hz
+
+        for (u8 nop = 0; nop < PROBE_NOPS[probe]; nop++)
+            rom.emit({ 0x00 });
+
+        rom.emit({ 0xF2 });                                                // LD A,(C): TIMA
+        rom.emit({ 0xEA, static_cast<u8>(probe), 0xC0 });                  // LD (C000 + probe),A
+    }
+
+    rom.emit({ 0x3E, 0x99, 0xEA, 0x10, 0xC0 });                            // Done marker
+    rom.label("end");
+    rom.jr(0x18, "end");
+
+    return rom;
+}
+
+int main()
+{
+    gb::test::TestROM rom = buildTestROM();
+
+    Scope<gb::GBConsole> console = std::make_unique<gb::GBConsole>();
+    gb::test::loadTestROM(*console, rom, "m_cycle_timing_test.gb");
+    gb::test::runFrames(*console, 400);
+
+    GB_CHECK(gb::test::bootROMFinished(*console));
+    GB_CHECK_EQ(console->read8(0xC010), 0x99);
+
+    for (u8 probe = 0; probe < PROBE_NOPS.size(); probe++)
+        GB_CHECK_EQ(console->read8(0xC000 + probe), EXPECTED_TIMA[probe]);
+
+    return gb::test::finish();
+}
@@ -0,0 +1,230 @@
+/*
+ * Copyright (C) 2023 pabletefest
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+// Mapper register behaviour driven through writeRegister: MBC1 bank 0 aliasing and mode 1 upper bits, MBC5 9th bank
+// bit, MBC3 clock latch, halt and day counter carry. Then the same banking seen through a GamePak
+
+#include "test_support.h"
+#include "mbc1.h"
+#include "mbc3.h"
+#include "mbc5.h"
+
+static constexpr u64 ONE_SECOND = gb::MBC3Mapper::RTC_CYCLES_PER_SECOND;
+
+static auto checkMBC1() -> void
+{
+    gb::MBC1Mapper mbc1(128, 4);
+
+    GB_CHECK_EQ(mbc1.getROMBank(0), 0);
+    GB_CHECK_EQ(mbc1.getROMBank(1), 1);
+
+    // The lower 5 bits are 5 bits wide and 0 selects bank 1, so 0x00, 0x20, 0x40 and 0x60 can't be mapped at 0x4000
+    mbc1.writeRegister(0x2000, 0x00);
+    GB_CHECK_EQ(mbc1.getROMBank(1), 1);
+    mbc1.writeRegister(0x2000, 0x20);
+    GB_CHECK_EQ(mbc1.getROMBank(1), 1);
+    mbc1.writeRegister(0x2000, 0x15);
+    GB_CHECK_EQ(mbc1.getROMBank(1), 0x15);
+
+    mbc1.writeRegister(0x4000, 0x01);
+    GB_CHECK_EQ(mbc1.getROMBank(1), 0x35);
+    mbc1.writeRegister(0x2000, 0x00);
+    GB_CHECK_EQ(mbc1.getROMBank(1), 0x21);
+
+    // Mode 0: the upper bits only apply to slot 1. Mode 1: slot 0 gets them too, and they select the RAM bank
+    GB_CHECK_EQ(mbc1.getROMBank(0), 0);
+    GB_CHECK_EQ(mbc1.getRAMBankOffset(), 0u);
+
+    mbc1.writeRegister(0x6000, 0x01);
+    GB_CHECK_EQ(mbc1.getROMBank(0), 0x20);
+    GB_CHECK_EQ(mbc1.getROMBank(1), 0x21);
+    GB_CHECK_EQ(mbc1.getRAMBankOffset(), 0x2000u);
+
+    mbc1.writeRegister(0x4000, 0x02);
+    GB_CHECK_EQ(mbc1.getROMBank(0), 0x40);
+    GB_CHECK_EQ(mbc1.getRAMBankOffset(), 0x4000u);
+
+    mbc1.writeRegister(0x6000, 0x00);
+    GB_CHECK_EQ(mbc1.getROMBank(0), 0);
+    GB_CHECK_EQ(mbc1.getROMBank(1), 0x41);
+    GB_CHECK_EQ(mbc1.getRAMBankOffset(), 0u);
+
+    // Smaller carts ignore the bank bits they don't have
+    gb::MBC1Mapper small(8, 0);
+    small.writeRegister(0x2000, 0x1D);
+    GB_CHECK_EQ(small.getROMBank(1), 0x1D % 8);
+
+    GB_CHECK(!mbc1.isRAMEnabled());
+    mbc1.writeRegister(0x0000, 0x0A);
+    GB_CHECK(mbc1.isRAMEnabled());
+    mbc1.writeRegister(0x0000, 0x00);
+    GB_CHECK(!mbc1.isRAMEnabled());
+}
+
+static auto checkMBC5() -> void
+{
+    gb::MBC5Mapper mbc5(512, 16);
+
+    GB_CHECK_EQ(mbc5.getROMBank(1), 1);
+
+    mbc5.writeRegister(0x2000, 0x05);
+    mbc5.writeRegister(0x3000, 0x01);
+    GB_CHECK_EQ(mbc5.getROMBank(1), 0x105);
+
+    // Unlike MBC1, bank 0 can be mapped at 0x4000, and each register keeps the other's bits
+    mbc5.writeRegister(0x2000, 0x00);
+    GB_CHECK_EQ(mbc5.getROMBank(1), 0x100);
+    mbc5.writeRegister(0x3000, 0x00);
+    GB_CHECK_EQ(mbc5.getROMBank(1), 0);
+    mbc5.writeRegister(0x2000, 0xFF);
+    mbc5.writeRegister(0x3000, 0xFF); // Only bit 0 is the 9th bit
+    GB_CHECK_EQ(mbc5.getROMBank(1), 0x1FF);
+    GB_CHECK_EQ(mbc5.getROMBank(0), 0);
+
+    mbc5.writeRegister(0x4000, 0x0F);
+    GB_CHECK_EQ(mbc5.getRAMBankOffset(), 0xF * 0x2000u);
+}
+
+static auto readRTC(gb::MBC3Mapper& mbc3, u8 reg) -> u8
+{
+    u8 data = 0;
+    mbc3.writeRegister(0x4000, reg);
+    mbc3.readRAMRegister(0xA000, data);
+
+    return data;
+}
+
+static auto writeRTC(gb::MBC3Mapper& mbc3, u8 reg, u8 value) -> void
+{
+    mbc3.writeRegister(0x4000, reg);
+    mbc3.writeRAMRegister(0xA000, value);
+}
+
+static auto latchRTC(gb::MBC3Mapper& mbc3) -> void
+{
+    mbc3.writeRegister(0x6000, 0x00);
+    mbc3.writeRegister(0x6000, 0x01);
+}
+
+static auto checkMBC3() -> void
+{
+    u64 cycles = 0;
+    gb::MBC3Mapper mbc3(128, 4, true);
+    mbc3.setCycleCounter(&cycles);
+
+    mbc3.writeRegister(0x2000, 0x00);
+    GB_CHECK_EQ(mbc3.getROMBank(1), 1);
+    mbc3.writeRegister(0x2000, 0x7F);
+    GB_CHECK_EQ(mbc3.getROMBank(1), 0x7F);
+
+    // Clock registers read 0xFF while disabled, and writes are ignored
+    u8 data = 0;
+    mbc3.writeRegister(0x4000, 0x08);
+    GB_CHECK(mbc3.readRAMRegister(0xA000, data));
+    GB_CHECK_EQ(data, 0xFF);
+    GB_CHECK(!mbc3.isRAMEnabled()); // The RAM window shows the clock, not RAM
+
+    mbc3.writeRegister(0x0000, 0x0A);
+    writeRTC(mbc3, 0x08, 10);
+
+    // Reads come from the latched copy, which only a 0x00 -> 0x01 write sequence updates
+    GB_CHECK_EQ(readRTC(mbc3, 0x08), 0);
+    latchRTC(mbc3);
+    GB_CHECK_EQ(readRTC(mbc3, 0x08), 10);
+
+    cycles += 3 * ONE_SECOND;
+    GB_CHECK_EQ(readRTC(mbc3, 0x08), 10);
+    mbc3.writeRegister(0x6000, 0x01);
+    GB_CHECK_EQ(readRTC(mbc3, 0x08), 10);
+    latchRTC(mbc3);
+    GB_CHECK_EQ(readRTC(mbc3, 0x08), 13);
+
+    // Halted, the clock keeps its value however long the cartridge runs
+    writeRTC(mbc3, 0x0C, 0x40);
+    cycles += 100 * ONE_SECOND;
+    latchRTC(mbc3);
+    GB_CHECK_EQ(readRTC(mbc3, 0x08), 13);
+    GB_CHECK_EQ(readRTC(mbc3, 0x0C), 0x40);
+
+    writeRTC(mbc3, 0x0C, 0x00);
+    cycles += ONE_SECOND / 2;
+    latchRTC(mbc3);
+    GB_CHECK_EQ(readRTC(mbc3, 0x08), 13);
+    cycles += ONE_SECOND / 2;
+    latchRTC(mbc3);
+    GB_CHECK_EQ(readRTC(mbc3, 0x08), 14);
+
+    // Day 511, 23:59:59 -> one second later the 9 bit day counter wraps and sets the carry, which stays set
+    writeRTC(mbc3, 0x08, 59);
+    writeRTC(mbc3, 0x09, 59);
+    writeRTC(mbc3, 0x0A, 23);
+    writeRTC(mbc3, 0x0B, 0xFF);
+    writeRTC(mbc3, 0x0C, 0x01);
+    cycles += ONE_SECOND;
+    latchRTC(mbc3);
+
+    GB_CHECK_EQ(readRTC(mbc3, 0x08), 0);
+    GB_CHECK_EQ(readRTC(mbc3, 0x09), 0);
+    GB_CHECK_EQ(readRTC(mbc3, 0x0A), 0);
+    GB_CHECK_EQ(readRTC(mbc3, 0x0B), 0);
+    GB_CHECK_EQ(readRTC(mbc3, 0x0C), 0x80);
+
+    cycles += 24 * 3600 * ONE_SECOND;
+    latchRTC(mbc3);
+    GB_CHECK_EQ(readRTC(mbc3, 0x0B), 1);
+    GB_CHECK_EQ(readRTC(mbc3, 0x0C), 0x80);
+
+    // Only the game clears it
+    writeRTC(mbc3, 0x0C, 0x00);
+    latchRTC(mbc3);
+    GB_CHECK_EQ(readRTC(mbc3, 0x0C), 0x00);
+
+    // Selecting a RAM bank again shows RAM in the window
+    mbc3.writeRegister(0x4000, 0x02);
+    GB_CHECK(!mbc3.readRAMRegister(0xA000, data));
+    GB_CHECK(mbc3.isRAMEnabled());
+    GB_CHECK_EQ(mbc3.getRAMBankOffset(), 0x4000u);
+}
+
+static auto checkGamePakBanking() -> void
+{
+    // Every bank starts with its own number, so reads tell which one is mapped
+    gb::test::TestROM rom(128, 0x01); // MBC1, 2 MiB
+
+    for (u32 bank = 1; bank < 128; bank++)
+        rom[bank * 0x4000] = static_cast<u8>(bank);
+
+    rom.writeFile("mapper_test.gb");
+    gb::GamePak cartridge("mapper_test.gb");
+
+    u8 data = 0;
+    cartridge.write(0x2000, 0x00);
+    cartridge.read(0x4000, data);
+    GB_CHECK_EQ(cartridge.getMappedROMBank(1), 1);
+    GB_CHECK_EQ(data, 1);
+
+    cartridge.write(0x4000, 0x03);
+    cartridge.write(0x2000, 0x05);
+    cartridge.read(0x4000, data);
+    GB_CHECK_EQ(cartridge.getMappedROMBank(1), 0x65);
+    GB_CHECK_EQ(data, 0x65);
+
+    cartridge.write(0x6000, 0x01);
+    cartridge.read(0x0000, data);
+    GB_CHECK_EQ(cartridge.getMappedROMBank(0), 0x60);
+    GB_CHECK_EQ(data, 0x60);
+}
+
+int main()
+{
+    checkMBC1();
+    checkMBC5();
+    checkMBC3();
+    checkGamePakBanking();
+
+    return gb::test::finish();
+}
@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2023 pabletefest
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+// OAM DMA from a switched ROM bank and from WRAM, with the LCD on (OAM scanned during the transfer) and off: the
+// copied bytes, what the CPU reads from the busy bus and from OAM meanwhile, and a transfer restarted halfway
+
+#include "test_support.h"
+
+#include <vector>
+
+// The bus conflict read lands one M-cycle later when LD A,(nn) reads on its last M-cycle
+#ifdef GB_CPU_M_CYCLE_ACCURATE
+static constexpr u8 EXPECTED_CONFLICT_INDEX = 3;
+#else
+static constexpr u8 EXPECTED_CONFLICT_INDEX = 2;
+#endif
+
+// Both variants end on the same OAM (the restarted transfer's), drawn with solid tiles over the boot logo
+static constexpr u32 EXPECTED_FRAME_HASH = 0x134BA1C5;
+
+static constexpr u8 ROM_PATTERN = 0x5A;
+static constexpr u8 WRAM_PATTERN = 0xA5;
+
+static auto buildTestROM(bool lcdOff) -> gb::test::TestROM
+{
+    gb::test::TestROM rom(4, 0x01); // MBC1
+
+    for (u32 i = 0; i < 160; i++)
+        rom[2 * 0x4000 + 0x100 + i] = static_cast<u8>(i ^ ROM_PATTERN);
+
+    // HRAM routines: plain transfer from bank 2 (4100), the same while reading the ROM bus and OAM, and one
+    // restarted from C200 about 20 M-cycles in
+    const std::vector<u8> plainTransfer = { 0x3E, 0x41, 0xE0, 0x46, 0x3E, 0x28, 0x3D, 0x20, 0xFD, 0xC9 };
+    const std::vector<u8> conflictTransfer = { 0x3E, 0x41, 0xE0, 0x46, 0xFA, 0x00, 0x00, 0xE0, 0xF0, 0xFA, 0x00, 0xFE,
+                                               0xE0, 0xF1, 0x3E, 0x28, 0x3D, 0x20, 0xFD, 0xC9 };
+    const std::vector<u8> restartedTransfer = { 0x3E, 0x41, 0xE0, 0x46, 0x3E, 0x05, 0x3D, 0x20, 0xFD, 0x3E, 0xC2, 0xE0,
+                                                0x46, 0x3E, 0x28, 0x3D, 0x20, 0xFD, 0xC9 };
+
+    rom.org(0x1000);
+    for (u8 byte : plainTransfer) rom.emit({ byte });
+    rom.org(0x1040);
+    for (u8 byte : conflictTransfer) rom.emit({ byte });
+    rom.org(0x1080);
+    for (u8 byte : restartedTransfer) rom.emit({ byte });
+
+    rom.org(0x150);
+    rom.emit({ 0xF3, 0x31, 0xFE, 0xFF });                                  // DI; LD SP,FFFE
+
+    if (lcdOff)
+        rom.emit({ 0xAF, 0xE0, 0x40 });                                    // LCDC = 0
+
+    rom.emit({ 0x3E, 0x02, 0xEA, 0x00, 0x20 });                            // ROM bank 2
+
+    // Routines to HRAM (FF80, FFA0, FFC0)
+    rom.emit({ 0x21, 0x00, 0x10, 0x0E, 0x80, 0x06, static_cast<u8>(plainTransfer.size()) });
+    rom.label("copy1");
+    rom.emit({ 0x2A, 0xE2, 0x0C, 0x05 });                                  // LD A,(HL+); LD (C),A; INC C; DEC B
+    rom.jr(0x20, "copy1");
+    rom.emit({ 0x21, 0x40, 0x10, 0x0E, 0xA0, 0x06, static_cast<u8>(conflictTransfer.size()) });
+    rom.label("copy2");
+    rom.emit({ 0x2A, 0xE2, 0x0C, 0x05 });
+    rom.jr(0x20, "copy2");
+    rom.emit({ 0x21, 0x80, 0x10, 0x0E, 0xC0, 0x06, static_cast<u8>(restartedTransfer.size()) });
+    rom.label("copy3");
+    rom.emit({ 0x2A, 0xE2, 0x0C, 0x05 });
+    rom.jr(0x20, "copy3");
+
+    // C200 pattern for the restarted transfer
+    rom.emit({ 0x21, 0x00, 0xC2, 0x06, 0x00 });                            // LD HL,C200; LD B,0
+    rom.label("pattern");
+    rom.emit({ 0x78, 0xEE, WRAM_PATTERN, 0x22, 0x04, 0x78, 0xFE, 160 });   // LD A,B; XOR; LD (HL+),A; INC B; CP 160
+    rom.jr(0x20, "pattern");
+
+    rom.emit({ 0xCD, 0x80, 0xFF });                                        // Plain transfer
+    rom.emit({ 0x21, 0x00, 0xFE, 0x11, 0x00, 0xC0, 0x06, 160 });           // OAM copied to C000
+    rom.label("save1");
+    rom.emit({ 0x2A, 0x12, 0x13, 0x05 });
+    rom.jr(0x20, "save1");
+
+    rom.emit({ 0xCD, 0xA0, 0xFF });                                        // Transfer with the conflict reads
+
+    rom.emit({ 0xCD, 0xC0, 0xFF });                                        // Restarted transfer
+    rom.emit({ 0x21, 0x00, 0xFE, 0x11, 0x00, 0xC3, 0x06, 160 });           // OAM copied to C300
+    rom.label("save2");
+    rom.emit({ 0x2A, 0x12, 0x13, 0x05 });
+    rom.jr(0x20, "save2");
+
+    // Solid tiles, then LCD and sprites on so the copied OAM shows in the frame
+    rom.emit({ 0xAF, 0xE0, 0x40, 0x21, 0x00, 0x80 });                      // LCDC = 0; LD HL,8000
+    rom.label("tiles");
+    rom.emit({ 0x3E, 0xFF, 0x22, 0x7C, 0xFE, 0x88 });                      // LD A,FF; LD (HL+),A; LD A,H; CP 88
+    rom.jr(0x20, "tiles");
+    rom.emit({ 0x3E, 0x93, 0xE0, 0x40 });
+    rom.emit({ 0x3E, 0x99, 0xEA, 0x00, 0xC1 });                            // Done marker
+    rom.label("end");
+    rom.jr(0x18, "end");
+
+    return rom;
+}
+
+static auto checkTransfers(bool lcdOff) -> void
+{
+    gb::test::TestROM rom = buildTestROM(lcdOff);
+
+    Scope<gb::GBConsole> console = std::make_unique<gb::GBConsole>();
+    gb::test::loadTestROM(*console, rom, lcdOff ? "oam_dma_test_lcd_off.gb" : "oam_dma_test_lcd_on.gb");
+    gb::test::runFrames(*console, 600);
+
+    GB_CHECK(gb::test::bootROMFinished(*console));
+    GB_CHECK_EQ(console->read8(0xC100), 0x99);
+
+    u32 wrongBytes = 0;
+
+    for (u16 i = 0; i < 160; i++)
+    {
+        wrongBytes += console->read8(0xC000 + i) != (i ^ ROM_PATTERN);
+        wrongBytes += console->read8(0xC300 + i) != (i ^ WRAM_PATTERN);
+    }
+
+    GB_CHECK_EQ(wrongBytes, 0u);
+    GB_CHECK_EQ(console->read8(0xFFF0), EXPECTED_CONFLICT_INDEX ^ ROM_PATTERN); // ROM bus: the byte being copied
+    GB_CHECK_EQ(console->read8(0xFFF1), 0xFF); // OAM is blocked
+    GB_CHECK_EQ(gb::test::hashFrame(console->getPPU()), EXPECTED_FRAME_HASH);
+}
+
+int main()
+{
+    checkTransfers(false);
+    checkTransfers(true);
+
+    return gb::test::finish();
+}
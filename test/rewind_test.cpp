@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2023 pabletefest
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+// Rewind history: every snapshot walked back to has to restore the exact save state captured at that point, also
+// once the ring has dropped its oldest deltas and after resuming from a rewound point
+
+#include "activity_rom.h"
+#include "rewind.h"
+
+#include <vector>
+
+static constexpr u16 FRAMES_PER_SNAPSHOT = 5;
+static constexpr u32 SNAPSHOTS_TO_TAKE = 80;
+static constexpr u32 SMALL_CAPACITY = 8 * 1024; // Holds a fraction of them, the oldest get evicted
+
+// Runs frames until the buffer has taken `count` snapshots, keeping a copy of each one
+static auto captureSnapshots(gb::GBConsole& console, gb::RewindBuffer& rewind, u32 count, std::vector<std::vector<u8>>& captured) -> void
+{
+    while (count > 0)
+    {
+        gb::test::runFrames(console, 1);
+
+        if (rewind.onFrameCompleted(console))
+        {
+            captured.push_back(rewind.getLatestState());
+            count--;
+        }
+    }
+}
+
+// Steps back `count` times (or until the history runs out), checking each restored state against the copies.
+// Returns how many steps were taken
+static auto walkBack(gb::GBConsole& console, gb::RewindBuffer& rewind, u32 count, std::vector<std::vector<u8>>& captured) -> u32
+{
+    std::vector<u8> state;
+    u32 steps = 0;
+
+    while (steps < count && rewind.stepBack(console))
+    {
+        console.saveState(state);
+
+        GB_CHECK(!captured.empty() && state == captured.back());
+
+        if (!captured.empty())
+            captured.pop_back();
+
+        steps++;
+    }
+
+    return steps;
+}
+
+int main()
+{
+    gb::test::TestROM rom = gb::test::buildActivityROM();
+
+    Scope<gb::GBConsole> console = std::make_unique<gb::GBConsole>();
+    gb::test::loadTestROM(*console, rom, "rewind_test.gb");
+    gb::test::runFrames(*console, 400); // Past the boot ROM
+    GB_CHECK(gb::test::bootROMFinished(*console));
+
+    // Room for everything: all the snapshots come back, newest first
+    {
+        gb::RewindBuffer rewind(GB_REWIND_BUFFER_SIZE, FRAMES_PER_SNAPSHOT);
+        std::vector<std::vector<u8>> captured;
+
+        captureSnapshots(*console, rewind, SNAPSHOTS_TO_TAKE, captured);
+        GB_CHECK_EQ(rewind.getStats().snapshotsStored, SNAPSHOTS_TO_TAKE);
+
+        GB_CHECK_EQ(walkBack(*console, rewind, SNAPSHOTS_TO_TAKE + 1, captured), SNAPSHOTS_TO_TAKE);
+        GB_CHECK(captured.empty());
+    }
+
+    // Small ring: only the newest snapshots survive, and they still decode exactly
+    {
+        gb::RewindBuffer rewind(SMALL_CAPACITY, FRAMES_PER_SNAPSHOT);
+        std::vector<std::vector<u8>> captured;
+
+        captureSnapshots(*console, rewind, SNAPSHOTS_TO_TAKE, captured);
+
+        u32 stored = rewind.getStats().snapshotsStored;
+        GB_CHECK(stored > 1 && stored < SNAPSHOTS_TO_TAKE);
+        GB_CHECK(rewind.getStats().bytesUsed <= SMALL_CAPACITY);
+
+        // Part of the way back, then history is rebuilt from there
+        u32 firstWalk = stored / 2;
+        GB_CHECK_EQ(walkBack(*console, rewind, firstWalk, captured), firstWalk);
+
+        captureSnapshots(*console, rewind, SNAPSHOTS_TO_TAKE, captured);
+        stored = rewind.getStats().snapshotsStored;
+
+        GB_CHECK_EQ(walkBack(*console, rewind, SNAPSHOTS_TO_TAKE * 2, captured), stored);
+        GB_CHECK(!rewind.stepBack(*console));
+    }
+
+    return gb::test::finish();
+}
@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2023 pabletefest
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+// Save state round trip (the restored machine replays the same frames) and rejection of blobs with a wrong magic,
+// version, ROM checksum or size, which must leave the running machine untouched
+
+#include "activity_rom.h"
+#include "save_state.h"
+
+#include <cstddef>
+#include <vector>
+
+static constexpr u32 FRAMES_BEFORE_SAVE = 400; // Past the boot ROM
+static constexpr u32 FRAMES_TO_REPLAY = 120;
+
+static auto recordFrames(gb::GBConsole& console, u32 frames) -> std::vector<u32>
+{
+    std::vector<u32> hashes;
+
+    for (u32 frame = 0; frame < frames; frame++)
+    {
+        gb::test::runFrames(console, 1);
+        hashes.push_back(gb::test::hashFrame(console.getPPU()));
+    }
+
+    return hashes;
+}
+
+static auto checkRejected(gb::GBConsole& console, const std::vector<u8>& blob) -> void
+{
+    std::vector<u8> before;
+    std::vector<u8> after;
+
+    console.saveState(before);
+    GB_CHECK(!console.loadState(blob.data(), static_cast<u32>(blob.size())));
+    console.saveState(after);
+
+    GB_CHECK(before == after);
+}
+
+int main()
+{
+    gb::test::TestROM rom = gb::test::buildActivityROM();
+
+    Scope<gb::GBConsole> console = std::make_unique<gb::GBConsole>();
+    gb::test::loadTestROM(*console, rom, "save_state_test.gb");
+    gb::test::runFrames(*console, FRAMES_BEFORE_SAVE);
+    GB_CHECK(gb::test::bootROMFinished(*console));
+
+    std::vector<u8> state;
+    console->saveState(state);
+
+    std::vector<u32> expectedFrames = recordFrames(*console, FRAMES_TO_REPLAY);
+
+    // Restored, the state reads back byte for byte and the same frames follow
+    GB_CHECK(console->loadState(state.data(), static_cast<u32>(state.size())));
+
+    std::vector<u8> restored;
+    console->saveState(restored);
+    GB_CHECK(restored == state);
+    GB_CHECK(recordFrames(*console, FRAMES_TO_REPLAY) == expectedFrames);
+
+    // Loaded while clock() is partway through an instruction, the next call runs the restored machine straight away
+    console->clock();
+    GB_CHECK(console->loadState(state.data(), static_cast<u32>(state.size())));
+
+    u64 loadedCycles = console->getCyclesElapsed();
+    console->clock();
+    GB_CHECK(console->getCyclesElapsed() > loadedCycles);
+
+    // Into a freshly booted console too
+    Scope<gb::GBConsole> other = std::make_unique<gb::GBConsole>();
+    gb::test::insertTestROM(*other, "save_state_test.gb");
+    GB_CHECK(other->loadState(state.data(), static_cast<u32>(state.size())));
+    GB_CHECK(recordFrames(*other, FRAMES_TO_REPLAY) == expectedFrames);
+
+    // Broken blobs are turned down before anything is written
+    std::vector<u8> badMagic = state;
+    badMagic[0] ^= 0xFF;
+    checkRejected(*console, badMagic);
+
+    std::vector<u8> badVersion = state;
+    badVersion[offsetof(gb::SaveStateHeader, version)] ^= 0x01;
+    checkRejected(*console, badVersion);
+
+    std::vector<u8> badChecksum = state;
+    badChecksum[offsetof(gb::SaveStateHeader, romGlobalChecksum)] ^= 0x01;
+    checkRejected(*console, badChecksum);
+
+    std::vector<u8> truncated(state.begin(), state.end() - 1);
+    checkRejected(*console, truncated);
+
+    std::vector<u8> extended = state;
+    extended.push_back(0x00);
+    checkRejected(*console, extended);
+
+    std::vector<u8> headerOnly(state.begin(), state.begin() + sizeof(gb::SaveStateHeader) - 1);
+    checkRejected(*console, headerOnly);
+
+    return gb::test::finish();
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2023 pabletefest
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+// HALT with IME off and an interrupt already pending (the HALT bug runs the next byte twice), then STOP: DIV reset,
+// no time passing until a selected button is pressed, and the joypad interrupt raised by the wake-up
+
+#include "test_support.h"
+
+// Boot logo left on screen, the ROM never touches VRAM
+static constexpr u32 EXPECTED_FRAME_HASH = 0x7ACE25B5;
+
+static auto buildTestROM() -> gb::test::TestROM
+{
+    gb::test::TestROM rom;
+
+    rom.emit({ 0xF3, 0x31, 0xFF, 0xDF });                                  // DI; LD SP,DFFF
+    rom.emit({ 0xAF, 0xE0, 0x0F });                                        // IF = 0
+    rom.emit({ 0x3E, 0x04, 0xE0, 0xFF, 0x3E, 0x04, 0xE0, 0x0F });          // IE = IF = timer
+    rom.emit({ 0xAF, 0x76, 0x3C });                                        // XOR A; HALT; INC A (runs twice)
+    rom.emit({ 0xEA, 0x00, 0xC0 });                                        // LD (C000),A
+    rom.emit({ 0x3E, 0x20, 0xE0, 0x00 });                                  // Select the d-pad lines
+    rom.emit({ 0x10, 0x00 });                                              // STOP
+    rom.emit({ 0x3E, 0x55, 0xEA, 0x01, 0xC0 });                            // LD A,55; LD (C001),A
+    rom.label("end");
+    rom.jr(0x18, "end");
+
+    return rom;
+}
+
+int main()
+{
+    gb::test::TestROM rom = buildTestROM();
+
+    Scope<gb::GBConsole> console = std::make_unique<gb::GBConsole>();
+    gb::test::loadTestROM(*console, rom, "stop_halt_test.gb");
+    gb::test::runFrames(*console, 600);
+
+    GB_CHECK(gb::test::bootROMFinished(*console));
+    GB_CHECK(console->isStopped());
+    GB_CHECK_EQ(console->read8(0xC000), 2);
+    GB_CHECK_EQ(console->read8(0xC001), 0x00);
+    GB_CHECK_EQ(console->read8(0xFF04), 0x00);
+
+    // Stopped, nothing moves however long the host keeps running it
+    u64 stoppedAt = console->getCyclesElapsed();
+    gb::test::runFrames(*console, 10);
+
+    GB_CHECK(console->isStopped());
+    GB_CHECK_EQ(console->getCyclesElapsed(), stoppedAt);
+
+    // A button on an unselected line doesn't wake it up, one on the d-pad does
+    console->controllerState.buttons &= ~0x01;
+    console->run(gb::GBConsole::CYCLES_PER_FRAME);
+    GB_CHECK(console->isStopped());
+
+    console->controllerState.buttons |= 0x01;
+    console->controllerState.dpad &= ~0x01;
+    console->run(gb::GBConsole::CYCLES_PER_FRAME); // Polls the buttons, like the ESP32 loop does while stopped
+    gb::test::runFrames(*console, 60);
+    console->controllerState.dpad |= 0x01;
+
+    GB_CHECK(!console->isStopped());
+    GB_CHECK_EQ(console->read8(0xC001), 0x55);
+    GB_CHECK((console->read8(0xFF0F) & 0x10) != 0);
+    GB_CHECK_EQ(gb::test::hashFrame(console->getPPU()), EXPECTED_FRAME_HASH);
+
+    return gb::test::finish();
+}
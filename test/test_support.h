@@ -0,0 +1,246 @@
+/*
+ * Copyright (C) 2023 pabletefest
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#pragma once
+#include "emu_typedefs.h"
+#include "bootrom.h"
+#include "gb.h"
+#include "game_pack.h"
+#include "ppu.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <initializer_list>
+#include <map>
+#include <string>
+#include <vector>
+
+// Host checks run by CTest (see test/CMakeLists.txt). Each test is a plain executable: failed checks are reported
+// and counted, the exit code tells CTest whether everything passed
+
+namespace gb::test
+{
+    inline u32 failedChecks = 0;
+
+    inline auto toHex(u64 value) -> std::string
+    {
+        char text[17];
+        snprintf(text, sizeof(text), "%llX", static_cast<unsigned long long>(value));
+        return text;
+    }
+
+    inline auto reportFailure(const char* file, int line, const std::string& message) -> void
+    {
+        printf("%s:%d: check failed: %s\n", file, line, message.c_str());
+        failedChecks++;
+    }
+
+    inline auto finish() -> int
+    {
+        if (failedChecks > 0)
+        {
+            printf("%u check(s) failed\n", failedChecks);
+            return EXIT_FAILURE;
+        }
+
+        printf("All checks passed\n");
+        return EXIT_SUCCESS;
+    }
+
+    // FNV-1a, the same hash the native runner prints
+    inline auto hashBytes(const u8* data, size_t size) -> u32
+    {
+        u32 hash = 2166136261u;
+
+        for (size_t i = 0; i < size; i++)
+        {
+            hash ^= data[i];
+            hash *= 16777619u;
+        }
+
+        return hash;
+    }
+
+    inline auto hashBytes(const std::vector<u8>& data) -> u32
+    {
+        return hashBytes(data.data(), data.size());
+    }
+
+    inline auto hashFrame(gb::PPU& ppu) -> u32
+    {
+        return hashBytes(ppu.getPixelsBufferData(), GB_PIXELS_WIDTH * GB_PIXELS_HEIGHT * sizeof(u16));
+    }
+
+    // Same frame pacing as the native runner: a frame ends when the PPU completes one, on STOP, or after a frame's
+    // worth of cycles when the LCD is off
+    inline auto runFrames(gb::GBConsole& console, u32 frames, bool cycleStepped = false) -> void
+    {
+        for (u32 frame = 0; frame < frames && !console.isStopped(); frame++)
+        {
+            u64 frameDeadline = console.getCyclesElapsed() + gb::GBConsole::CYCLES_PER_FRAME;
+
+            do
+            {
+                if (cycleStepped)
+                    console.clock();
+                else
+                    console.run(static_cast<u32>(frameDeadline - console.getCyclesElapsed()));
+            } while (!console.getPPU().frameCompleted && !console.isStopped() && console.getCyclesElapsed() < frameDeadline);
+
+            console.getPPU().frameCompleted = false;
+        }
+    }
+
+    inline auto bootROMFinished(gb::GBConsole& console) -> bool
+    {
+        return (console.read8(0xFF50) & 0x01) != 0;
+    }
+
+    // Tiny assembler for synthetic test ROMs: raw opcodes plus labels for the jump targets. build() fills in a header
+    // the boot ROM accepts (logo copied from the boot ROM itself, header checksum), so the tests run through it
+    class TestROM
+    {
+    public:
+        TestROM(u16 numROMBanks = 2, u8 cartridgeType = 0x00, u8 ramSizeCode = 0x00)
+            : rom(numROMBanks * 0x4000, 0x00)
+        {
+            rom[0x147] = cartridgeType;
+            rom[0x149] = ramSizeCode;
+
+            for (u8 sizeCode = 0; (0x8000u << sizeCode) < rom.size(); sizeCode++)
+                rom[0x148] = sizeCode + 1;
+
+            // Entry point: NOP; JP 0x0150
+            org(0x100);
+            emit({ 0x00, 0xC3, 0x50, 0x01 });
+            org(0x150);
+        }
+
+        auto org(u32 address) -> void { pc = address; }
+        auto here() const -> u32 { return pc; }
+
+        auto emit(std::initializer_list<u8> bytes) -> void
+        {
+            for (u8 byte : bytes)
+                rom[pc++] = byte;
+        }
+
+        auto label(const std::string& name) -> void { labels[name] = pc; }
+
+        // JR/JR cc with a label target
+        auto jr(u8 opcode, const std::string& target) -> void
+        {
+            emit({ opcode });
+            fixups.push_back({ pc, target, true });
+            emit({ 0x00 });
+        }
+
+        // JP/CALL (any condition) with a label target, the label must be in bank 0 or in the bank mapped at 0x4000
+        auto abs16(u8 opcode, const std::string& target) -> void
+        {
+            emit({ opcode });
+            fixups.push_back({ pc, target, false });
+            emit({ 0x00, 0x00 });
+        }
+
+        auto operator[](u32 offset) -> u8& { return rom[offset]; }
+
+        auto build() -> const std::vector<u8>&
+        {
+            for (const Fixup& fixup : fixups)
+            {
+                u32 target = labels.at(fixup.target);
+                u16 address = static_cast<u16>(target < 0x4000 ? target : 0x4000 + (target & 0x3FFF));
+
+                if (fixup.relative)
+                {
+                    s32 offset = static_cast<s32>(target) - static_cast<s32>(fixup.offset + 1);
+
+                    if (offset < -128 || offset > 127)
+                        printf("TestROM: JR to '%s' out of range\n", fixup.target.c_str());
+
+                    rom[fixup.offset] = static_cast<u8>(offset);
+                }
+                else
+                {
+                    rom[fixup.offset] = address & 0xFF;
+                    rom[fixup.offset + 1] = address >> 8;
+                }
+            }
+
+            for (u32 i = 0; i < 0x30; i++)
+                rom[0x104 + i] = boot_rom[0xA8 + i];
+
+            u8 checksum = 0;
+
+            for (u32 address = 0x134; address <= 0x14C; address++)
+                checksum = checksum - rom[address] - 1;
+
+            rom[0x14D] = checksum;
+
+            return rom;
+        }
+
+        // Written to the test's working directory, GamePak only loads from files
+        auto writeFile(const std::string& path) -> bool
+        {
+            build();
+
+            std::ofstream ofs(path, std::ofstream::binary | std::ofstream::trunc);
+            ofs.write(reinterpret_cast<const char*>(rom.data()), rom.size());
+
+            return ofs.good();
+        }
+
+    private:
+        struct Fixup
+        {
+            u32 offset;
+            std::string target;
+            bool relative;
+        };
+
+        std::vector<u8> rom;
+        std::map<std::string, u32> labels;
+        std::vector<Fixup> fixups;
+        u32 pc = 0;
+    };
+
+    // Boots a console with a ROM file loadTestROM already wrote. The file is left alone, other consoles may have it
+    // mapped
+    inline auto insertTestROM(gb::GBConsole& console, const std::string& path) -> Ref<gb::GamePak>
+    {
+        Ref<gb::GamePak> cartridge = std::make_shared<gb::GamePak>(path);
+        console.insertCartridge(cartridge);
+        console.reset();
+
+        return cartridge;
+    }
+
+    // Writes the ROM (dropping any save file left by a previous run) and boots a console with it
+    inline auto loadTestROM(gb::GBConsole& console, TestROM& rom, const std::string& path) -> Ref<gb::GamePak>
+    {
+        rom.writeFile(path);
+        std::remove((path.substr(0, path.find_last_of('.')) + ".sav").c_str());
+
+        return insertTestROM(console, path);
+    }
+}
+
+#define GB_CHECK(condition) \
+    do { if (!(condition)) gb::test::reportFailure(__FILE__, __LINE__, #condition); } while (0)
+
+#define GB_CHECK_EQ(actual, expected) \
+    do \
+    { \
+        auto actualValue_ = (actual); \
+        auto expectedValue_ = (expected); \
+        if (!(actualValue_ == expectedValue_)) \
+            gb::test::reportFailure(__FILE__, __LINE__, std::string(#actual " == " #expected " (got 0x") + \
+                gb::test::toHex(static_cast<u64>(actualValue_)) + ", expected 0x" + gb::test::toHex(static_cast<u64>(expectedValue_)) + ")"); \
+    } while (0)